@@ -0,0 +1,44 @@
+#include <pebble.h>
+#include "battery_estimate.h"
+
+/* Keeps the last few battery readings and estimates the time left from the
+drain between the oldest and newest of them. Readings only come in when
+the level changes, so each new one costs a single multiply and divide. */
+
+void battery_history_reset(BatteryHistory *history) {
+  history->count = 0;
+  history->next = 0;
+  history->hours_left = -1;
+}
+
+void battery_history_add(BatteryHistory *history, time_t now, int percent) {
+  int newest = (history->next + BATTERY_HISTORY_LENGTH - 1) % BATTERY_HISTORY_LENGTH;
+
+  if (history->count > 0) {
+    if (percent == history->percent[newest]) return;
+
+    // Going up means it's charging, and the old drain rate no longer applies.
+
+    if (percent > history->percent[newest]) {
+      battery_history_reset(history);
+    }
+  }
+
+  history->percent[history->next] = percent;
+  history->time[history->next] = now;
+  history->next = (history->next + 1) % BATTERY_HISTORY_LENGTH;
+  if (history->count < BATTERY_HISTORY_LENGTH) {
+    history->count++;
+  }
+
+  int oldest = (history->next + BATTERY_HISTORY_LENGTH - history->count) % BATTERY_HISTORY_LENGTH;
+  int drained = history->percent[oldest] - percent;
+  int32_t elapsed = now - history->time[oldest];
+
+  if (drained > 0 && elapsed > 0) {
+    int32_t hours = elapsed * percent / drained / 3600;
+    history->hours_left = hours > 9999 ? 9999 : hours;
+  } else {
+    history->hours_left = -1;
+  }
+}
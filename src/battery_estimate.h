@@ -0,0 +1,15 @@
+#pragma once
+#include <pebble.h>
+
+#define BATTERY_HISTORY_LENGTH 8
+
+typedef struct {
+  uint8_t count, next;
+  int16_t hours_left; // -1 until two samples show a drain
+  uint8_t percent[BATTERY_HISTORY_LENGTH];
+  time_t time[BATTERY_HISTORY_LENGTH];
+} BatteryHistory;
+
+void battery_history_reset(BatteryHistory *history);
+
+void battery_history_add(BatteryHistory *history, time_t now, int percent);
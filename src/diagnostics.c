@@ -0,0 +1,166 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+
+Diagnostics diagnostics;
+
+static const char *latency_names[] = {
+  "up click", "up multi", "up long",
+  "select click", "select multi", "select long",
+  "down click", "down multi", "down long"
+};
+
+static const char *profile_names[] = {
+  "inbox", "minute tick", "tap", "click",
+  "battery gauge", "volume bar", "sparkline", "frame"
+};
+
+// Wraps every ~49 days, which is fine for measuring differences.
+
+uint32_t diagnostics_now_ms(void) {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)seconds * 1000 + ms;
+}
+
+// Every wakeup costs power, so timers are registered through here to be counted.
+
+AppTimer *diagnostics_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data) {
+  diagnostics.timers++;
+  return app_timer_register(timeout_ms, callback, data);
+}
+
+static void stat_record(HandlerStat *stat, uint32_t since_ms) {
+  uint32_t elapsed = diagnostics_now_ms() - since_ms;
+
+  stat->count++;
+  stat->total_ms += elapsed;
+  if (elapsed > stat->max_ms) {
+    stat->max_ms = elapsed;
+  }
+}
+
+static void stat_log(const char *name, HandlerStat *stat) {
+  if (stat->count == 0) return;
+  APP_LOG(APP_LOG_LEVEL_INFO, "%s: %lu calls, avg %lu ms, max %lu ms, total %lu ms",
+      name, (unsigned long)stat->count, (unsigned long)(stat->total_ms / stat->count),
+      (unsigned long)stat->max_ms, (unsigned long)stat->total_ms);
+}
+
+static int latency_pending = -1;
+static uint32_t latency_since;
+
+void diagnostics_latency_begin(LatencyHandler handler, uint32_t since_ms) {
+  latency_pending = handler;
+  latency_since = since_ms;
+}
+
+// Called by sm_message_out_get, right before the message is written and sent.
+
+void diagnostics_latency_sent(void) {
+  if (latency_pending < 0) return;
+  stat_record(&diagnostics.latency[latency_pending], latency_since);
+  latency_pending = -1;
+}
+
+void diagnostics_latency_end(void) {
+  latency_pending = -1;
+}
+
+void diagnostics_profile_record(ProfileHandler handler, uint32_t since_ms) {
+  stat_record(&diagnostics.profile[handler], since_ms);
+}
+
+// A whole window redraw, timed from the bottom layer's update proc to the
+// top one's.
+
+void diagnostics_frame_begin(void) {
+#ifdef WIZARD_PROFILE
+  diagnostics.frame_started = diagnostics_now_ms();
+#endif
+}
+
+void diagnostics_frame_end(void) {
+#ifdef WIZARD_PROFILE
+  diagnostics.last_frame_ms = diagnostics_now_ms() - diagnostics.frame_started;
+  diagnostics_profile_record(PROFILE_FRAME, diagnostics.frame_started);
+#endif
+}
+
+void diagnostics_hour_tick(void) {
+  diagnostics.redraws_last_hour = diagnostics.redraws_this_hour;
+  diagnostics.redraws_this_hour = 0;
+}
+
+/* Scales the energy counters to a full day. Pebble 2.x redraws the whole
+window whenever anything in it is dirty, so the dirty area is taken to be
+the full screen for every redraw. */
+
+#define PER_DAY(count) ((unsigned long)((uint64_t)(count) * 86400 / seconds))
+
+void diagnostics_budget_log(uint32_t seconds) {
+  if (seconds == 0) return;
+  APP_LOG(APP_LOG_LEVEL_INFO, "budget/day: %lu sent, %lu received, %lu vibrations",
+      PER_DAY(diagnostics.messages_sent),
+      PER_DAY(diagnostics.messages_received),
+      PER_DAY(diagnostics.vibrations));
+  APP_LOG(APP_LOG_LEVEL_INFO, "budget/day: %lu timers, %lu ticks, %lu redraws, %lu kpx dirty",
+      PER_DAY(diagnostics.timers),
+      PER_DAY(diagnostics.minute_ticks),
+      PER_DAY(diagnostics.redraws),
+      PER_DAY(diagnostics.redraws) * 144 * 168 / 1000);
+}
+
+void diagnostics_log(void) {
+  diagnostics_budget_log(time(NULL) - diagnostics.started);
+  APP_LOG(APP_LOG_LEVEL_INFO, "inbox: %lu accepted, %lu duplicate, %lu stale",
+      (unsigned long)diagnostics.inbox_accepted,
+      (unsigned long)diagnostics.inbox_duplicates,
+      (unsigned long)diagnostics.inbox_stale);
+  APP_LOG(APP_LOG_LEVEL_INFO, "redraws: %lu this hour, %lu last hour",
+      (unsigned long)diagnostics.redraws_this_hour,
+      (unsigned long)diagnostics.redraws_last_hour);
+
+  for (int i = 0; i < NUM_LATENCY_HANDLERS; i++) {
+    stat_log(latency_names[i], &diagnostics.latency[i]);
+  }
+  for (int i = 0; i < NUM_PROFILE_HANDLERS; i++) {
+    stat_log(profile_names[i], &diagnostics.profile[i]);
+  }
+}
+
+/* Sent as one byte array on SM_DIAGNOSTICS_KEY, little endian:
+
+  uint8 APP_VERSION, uint8 latency count, uint8 profile count,
+  uint32 inbox accepted, duplicate and stale,
+  uint32 redraws this hour and last hour,
+  uint32 seconds running, messages sent and received, vibrations,
+  timers, minute ticks and redraws,
+  then count, max ms and total ms (uint32 each) for each
+  latency handler followed by each profiled handler */
+
+void diagnostics_send(void) {
+  uint8_t buffer[3 + 12 * sizeof(uint32_t) + (NUM_LATENCY_HANDLERS + NUM_PROFILE_HANDLERS) * sizeof(HandlerStat)];
+  uint8_t *p = buffer;
+  uint32_t counters[] = {
+    diagnostics.inbox_accepted, diagnostics.inbox_duplicates, diagnostics.inbox_stale,
+    diagnostics.redraws_this_hour, diagnostics.redraws_last_hour,
+    time(NULL) - diagnostics.started, diagnostics.messages_sent, diagnostics.messages_received,
+    diagnostics.vibrations, diagnostics.timers, diagnostics.minute_ticks, diagnostics.redraws
+  };
+
+  *p++ = APP_VERSION;
+  *p++ = NUM_LATENCY_HANDLERS;
+  *p++ = NUM_PROFILE_HANDLERS;
+  memcpy(p, counters, sizeof(counters));
+  p += sizeof(counters);
+  memcpy(p, diagnostics.latency, sizeof(diagnostics.latency));
+  p += sizeof(diagnostics.latency);
+  memcpy(p, diagnostics.profile, sizeof(diagnostics.profile));
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return;
+  dict_write_data(iter, SM_DIAGNOSTICS_KEY, buffer, sizeof(buffer));
+  app_message_outbox_send();
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <pebble.h>
+
+// Running counters for field diagnostics, dumped over APP_LOG or sent to
+// the phone when it asks with SM_DIAGNOSTICS_KEY.
+
+/* Handler timing is only compiled in for profiling builds, enabled with
+WIZARD_PROFILE=1 in the environment when building. Wrap a handler body in
+PROFILE_BEGIN and PROFILE_END; the durations are in milliseconds. */
+
+#ifdef WIZARD_PROFILE
+  #define PROFILE_BEGIN(handler) uint32_t profile_started = diagnostics_now_ms()
+  #define PROFILE_END(handler) diagnostics_profile_record(handler, profile_started)
+#else
+  #define PROFILE_BEGIN(handler)
+  #define PROFILE_END(handler)
+#endif
+
+typedef enum {
+  PROFILE_INBOX,
+  PROFILE_MINUTE_TICK,
+  PROFILE_TAP,
+  PROFILE_CLICK,
+  PROFILE_BATTERY_GAUGE,
+  PROFILE_VOLUME_BAR,
+  PROFILE_SPARKLINE,
+  PROFILE_FRAME,
+  NUM_PROFILE_HANDLERS
+} ProfileHandler;
+
+// All 32 bit so the counts of per-frame handlers don't wrap on a worn watch,
+// and so the struct has no padding when sent as is.
+typedef struct {
+  uint32_t count;
+  uint32_t max_ms;
+  uint32_t total_ms;
+} HandlerStat;
+
+typedef enum {
+  LATENCY_UP_CLICK,
+  LATENCY_UP_MULTI_CLICK,
+  LATENCY_UP_LONG_CLICK,
+  LATENCY_SELECT_CLICK,
+  LATENCY_SELECT_MULTI_CLICK,
+  LATENCY_SELECT_LONG_CLICK,
+  LATENCY_DOWN_CLICK,
+  LATENCY_DOWN_MULTI_CLICK,
+  LATENCY_DOWN_LONG_CLICK,
+  NUM_LATENCY_HANDLERS
+} LatencyHandler;
+
+typedef struct {
+  time_t started;
+  uint32_t messages_sent;
+  uint32_t messages_received;
+  uint32_t vibrations;
+  uint32_t timers;
+  uint32_t minute_ticks;
+  uint32_t redraws;
+  uint32_t inbox_accepted;
+  uint32_t inbox_duplicates;
+  uint32_t inbox_stale;
+  HandlerStat latency[NUM_LATENCY_HANDLERS];
+  HandlerStat profile[NUM_PROFILE_HANDLERS];
+  uint32_t redraws_this_hour;
+  uint32_t redraws_last_hour;
+  uint32_t frame_started;
+  uint16_t last_frame_ms;
+} Diagnostics;
+
+extern Diagnostics diagnostics;
+
+uint32_t diagnostics_now_ms(void);
+
+AppTimer *diagnostics_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data);
+
+/* Click latency is measured from the press to the first message the
+click handler hands to the outbox. A handler starts with
+diagnostics_latency_begin and ends with diagnostics_latency_end; clicks
+that send nothing aren't recorded. */
+
+void diagnostics_latency_begin(LatencyHandler handler, uint32_t since_ms);
+
+void diagnostics_latency_sent(void);
+
+void diagnostics_latency_end(void);
+
+void diagnostics_profile_record(ProfileHandler handler, uint32_t since_ms);
+
+void diagnostics_frame_begin(void);
+
+void diagnostics_frame_end(void);
+
+void diagnostics_hour_tick(void);
+
+void diagnostics_budget_log(uint32_t seconds);
+
+void diagnostics_log(void);
+
+void diagnostics_send(void);
@@ -91,6 +91,7 @@
 #define SM_STOCKS_DETAIL				       0xFC57
 #define SM_CUSTOM_SMS				           0xFC58
 #define SM_VERSION_KEY				         0xFC59
+#define SM_DIAGNOSTICS_KEY             0xFC5A
 
 typedef enum {
   WeatherCondition,
@@ -118,6 +119,10 @@ typedef enum {CALENDAR_APP, MUSIC_APP, GPS_APP, SIRI_APP, STOCKS_APP, BITCOIN_AP
 
 static char *app_names[] = {"Calendar", "Music", "GPS", "Launch Siri", "Stocks", "Bitcoin", "Camera", "Weather", "HTTP Request", "Messages", "Incoming Calls", "Find My Phone", "Reminders", "Status", "Activator"};
 
+// Carousel panels, in order
+typedef enum {WEATHER_LAYER, CALENDAR_LAYER, MUSIC_LAYER, STOCKS_LAYER, BITCOIN_LAYER, NUM_LAYERS} AnimatedLayers;
+
+AppMessageResult sm_message_out_get(DictionaryIterator **iter_out);
 void sendCommand(int key);
 void sendCommandInt(int key, int param);
 void sendCommandStr(int key, int param, char *str);
@@ -0,0 +1,268 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+#include "list_view.h"
+
+/* Lists are fetched from the phone a page at a time and only the pages
+around the cursor are kept, so even long lists fit in the heap left over
+after the AppMessage buffers. Rows are stored in a ring indexed by row
+number; a slot only counts as loaded if it holds the row asked for.
+
+The phone answers a request (the list's key with the first row wanted)
+with a byte array on the same key:
+
+  uint16 total rows, uint16 first row, then title\0subtitle\0 per row */
+
+#define LIST_PAGE_SIZE 8
+#define LIST_RESIDENT_PAGES 3
+#define LIST_RESIDENT_ROWS (LIST_PAGE_SIZE * LIST_RESIDENT_PAGES)
+#define LIST_TEXT_LENGTH 32
+#define LIST_REQUEST_TIMEOUT 3000
+
+typedef struct {
+  int16_t index; // -1 when empty
+  char title[LIST_TEXT_LENGTH];
+  char subtitle[LIST_TEXT_LENGTH];
+} ListRow;
+
+static const uint32_t list_keys[NUM_LISTS] = {SM_REMINDERS_KEY, SM_MESSAGES_UPDATE_KEY};
+static const int list_apps[NUM_LISTS] = {REMINDERS_APP, MESSAGES_APP};
+
+static Window *list_window;
+static MenuLayer *list_menu;
+static AppTimer *request_timer;
+static ListRow *rows;
+static ListSource source;
+static int total, cursor, requested_page;
+
+// Screen changes for the phone, sent before any page request. -1 when
+// there's nothing to send.
+
+static int screen_exit = -1, screen_enter = -1;
+
+static bool page_wanted(int page) {
+  int cursor_page = cursor / LIST_PAGE_SIZE;
+  if (page < 0 || page < cursor_page - 1 || page > cursor_page + 1) return false;
+  return total < 0 || page * LIST_PAGE_SIZE < total;
+}
+
+static bool page_resident(int page) {
+  int first = page * LIST_PAGE_SIZE;
+  return rows[first % LIST_RESIDENT_ROWS].index == first;
+}
+
+// The page under the cursor comes first, then the one ahead of it so it's
+// already there by the time the cursor gets to it, then the one behind.
+
+static int next_page(void) {
+  int cursor_page = cursor / LIST_PAGE_SIZE;
+  int pages[] = {cursor_page, cursor_page + 1, cursor_page - 1};
+
+  for (unsigned int i = 0; i < ARRAY_LENGTH(pages); i++) {
+    if (page_wanted(pages[i]) && !page_resident(pages[i])) return pages[i];
+  }
+  return -1;
+}
+
+static void request_timed_out(void *data) {
+  request_timer = NULL;
+  requested_page = -1;
+  list_view_flush();
+}
+
+// Screen changes go out first, together in one message, and the page
+// request follows from the next outbox callback.
+
+static bool flush_screens(void) {
+  if (screen_exit < 0 && screen_enter < 0) return true;
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return false; // Retried once the outbox is free
+
+  if (screen_exit >= 0) dict_write_int8(iter, SM_SCREEN_EXIT_KEY, screen_exit);
+  if (screen_enter >= 0) dict_write_int8(iter, SM_SCREEN_ENTER_KEY, screen_enter);
+  if (app_message_outbox_send() != APP_MSG_OK) return false;
+
+  screen_exit = screen_enter = -1;
+  return false;
+}
+
+static void screen_change(int leaving, int entering) {
+  if (leaving >= 0 && screen_enter == leaving) {
+    screen_enter = -1; // Never got there, so there's nothing to leave
+  } else if (leaving >= 0) {
+    screen_exit = leaving;
+  }
+  if (entering >= 0) {
+    screen_enter = entering;
+  }
+}
+
+void list_view_flush(void) {
+  if (!flush_screens()) return;
+  if (list_window == NULL || requested_page >= 0) return;
+
+  int page = next_page();
+  if (page < 0) return;
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return; // Retried once the outbox is free
+
+  dict_write_uint16(iter, list_keys[source], page * LIST_PAGE_SIZE);
+  if (app_message_outbox_send() != APP_MSG_OK) return;
+
+  requested_page = page;
+  request_timer = diagnostics_timer_register(LIST_REQUEST_TIMEOUT, request_timed_out, NULL);
+}
+
+static const uint8_t *read_field(char *field, const uint8_t *data, const uint8_t *end) {
+  int length = 0;
+  while (data < end && *data != '\0') {
+    if (length < LIST_TEXT_LENGTH - 1) {
+      field[length++] = *data;
+    }
+    data++;
+  }
+  field[length] = '\0';
+  return data + 1;
+}
+
+void list_view_received(Tuple *t) {
+  if (list_window == NULL || t->key != list_keys[source] || t->type != TUPLE_BYTE_ARRAY || t->length < 4) return;
+
+  const uint8_t *data = t->value->data;
+  const uint8_t *end = data + t->length;
+  int index = data[2] | (data[3] << 8);
+
+  total = data[0] | (data[1] << 8);
+  if (index / LIST_PAGE_SIZE == requested_page) {
+    requested_page = -1;
+    if (request_timer) {
+      app_timer_cancel(request_timer);
+      request_timer = NULL;
+    }
+  }
+
+  // A late answer for a page we've since scrolled away from is dropped
+  // rather than evicting rows around the cursor.
+
+  if (page_wanted(index / LIST_PAGE_SIZE)) {
+    for (data += 4; data < end; index++) {
+      ListRow *row = &rows[index % LIST_RESIDENT_ROWS];
+      data = read_field(row->title, data, end);
+      data = read_field(row->subtitle, data, end);
+      row->index = index;
+    }
+  }
+
+  menu_layer_reload_data(list_menu);
+  list_view_flush();
+}
+
+static void list_reset(ListSource list_source) {
+  source = list_source;
+  total = -1;
+  cursor = 0;
+  requested_page = -1;
+  for (int i = 0; i < LIST_RESIDENT_ROWS; i++) {
+    rows[i].index = -1;
+  }
+}
+
+// MENU CALLBACKS
+
+static uint16_t get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return total < 0 ? 1 : total;
+}
+
+static int16_t get_header_height(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return 16;
+}
+
+static void draw_header(GContext* ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
+  menu_cell_basic_header_draw(ctx, cell_layer, app_names[list_apps[source]]);
+}
+
+static void draw_row(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  ListRow *row = &rows[cell_index->row % LIST_RESIDENT_ROWS];
+  if (row->index == cell_index->row) {
+    menu_cell_basic_draw(ctx, cell_layer, row->title, row->subtitle, NULL);
+  } else {
+    menu_cell_basic_draw(ctx, cell_layer, "...", NULL, NULL);
+  }
+}
+
+static void selection_changed(MenuLayer *menu_layer, MenuIndex new_index, MenuIndex old_index, void *data) {
+  cursor = new_index.row;
+  list_view_flush();
+}
+
+// Holding select flips between reminders and messages.
+
+static void select_long_click(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  int leaving = list_apps[source];
+  list_reset((source + 1) % NUM_LISTS);
+  menu_layer_reload_data(list_menu);
+  screen_change(leaving, list_apps[source]);
+  list_view_flush();
+}
+
+// WINDOW HANDLERS
+
+static void window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+
+  list_menu = menu_layer_create(layer_get_bounds(window_layer));
+  menu_layer_set_callbacks(list_menu, NULL, (MenuLayerCallbacks) {
+    .get_num_rows = get_num_rows,
+    .get_header_height = get_header_height,
+    .draw_header = draw_header,
+    .draw_row = draw_row,
+    .selection_changed = selection_changed,
+    .select_long_click = select_long_click
+  });
+  menu_layer_set_click_config_onto_window(list_menu, window);
+  layer_add_child(window_layer, menu_layer_get_layer(list_menu));
+}
+
+static void window_appear(Window *window) {
+  screen_change(-1, list_apps[source]);
+  list_view_flush();
+}
+
+static void window_disappear(Window *window) {
+  screen_change(list_apps[source], -1);
+  list_view_flush();
+}
+
+// Everything is freed on the way out; the rows are only worth keeping
+// while the list is on screen.
+
+static void window_unload(Window *window) {
+  if (request_timer) {
+    app_timer_cancel(request_timer);
+    request_timer = NULL;
+  }
+  menu_layer_destroy(list_menu);
+  free(rows);
+  rows = NULL;
+  window_destroy(list_window);
+  list_window = NULL;
+}
+
+void list_view_show(ListSource list_source) {
+  if (list_window) return;
+
+  rows = malloc(sizeof(ListRow) * LIST_RESIDENT_ROWS);
+  if (rows == NULL) return;
+  list_reset(list_source);
+
+  list_window = window_create();
+  window_set_window_handlers(list_window, (WindowHandlers) {
+       .load = window_load,
+     .unload = window_unload,
+     .appear = window_appear,
+  .disappear = window_disappear
+  });
+  window_stack_push(list_window, true);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <pebble.h>
+
+typedef enum {LIST_REMINDERS, LIST_MESSAGES, NUM_LISTS} ListSource;
+
+void list_view_show(ListSource list_source);
+
+void list_view_received(Tuple *t);
+
+void list_view_flush(void);
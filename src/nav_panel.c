@@ -0,0 +1,144 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+#include "nav_panel.h"
+
+/* Turn-by-turn directions take over the panel area while a route is
+active. The phone only sends an icon ID and the instruction; the icons
+live on the watch in one sheet. It repeats both with every distance
+update, so the icon and the text are separate layers and each is only
+marked dirty when its own value changes. An empty instruction ends the
+route, as does NAV_ROUTE_TIMEOUT without updates while connected. Losing
+the phone keeps the last instruction up, with the icon inverted to show
+it's no longer being updated. */
+
+#define NAV_ROUTE_TIMEOUT (10 * 60 * 1000)
+#define NAV_ICON_SIZE 32
+#define NAV_TEXT_LENGTH 64
+
+static Layer *icon_layer;
+static TextLayer *text_layer;
+static GBitmap *icon_sheet, *icons[NUM_NAV_ICONS];
+static char text[NAV_TEXT_LENGTH];
+static uint8_t icon = NUM_NAV_ICONS; // None yet
+static bool active, connected = true;
+static AppTimer *route_timer;
+static NavRouteChanged route_changed;
+
+static void route_set_active(bool route_active) {
+  if (active == route_active) return;
+  active = route_active;
+  route_changed();
+}
+
+static void route_end(void) {
+  if (route_timer) {
+    app_timer_cancel(route_timer);
+    route_timer = NULL;
+  }
+  text[0] = '\0';
+  icon = NUM_NAV_ICONS;
+  route_set_active(false);
+}
+
+static void route_timeout(void *data) {
+  route_timer = NULL;
+  route_end();
+}
+
+static void route_timer_restart(void) {
+  if (route_timer) {
+    app_timer_reschedule(route_timer, NAV_ROUTE_TIMEOUT);
+  } else {
+    route_timer = diagnostics_timer_register(NAV_ROUTE_TIMEOUT, route_timeout, NULL);
+  }
+}
+
+static void icon_update_proc(Layer *layer, GContext *ctx) {
+  if (icon >= NUM_NAV_ICONS) return;
+
+  graphics_context_set_compositing_mode(ctx, connected ? GCompOpAssign : GCompOpAssignInverted);
+  graphics_draw_bitmap_in_rect(ctx, icons[icon], layer_get_bounds(layer));
+}
+
+void nav_panel_received(Tuple *t) {
+  switch (t->key) {
+    case SM_NAV_ICON_KEY:
+      if (icon != t->value->uint8) {
+        icon = t->value->uint8;
+        layer_mark_dirty(icon_layer);
+      }
+    break;
+
+    case SM_NAV_INSTRUCTIONS_KEY:
+      if (t->value->cstring[0] == '\0') {
+        route_end();
+        return;
+      }
+      if (strncmp(text, t->value->cstring, sizeof(text) - 1) != 0) {
+        strncpy(text, t->value->cstring, sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        text_layer_set_text(text_layer, text);
+      }
+    break;
+  }
+
+  route_timer_restart();
+  route_set_active(true);
+}
+
+bool nav_panel_active(void) {
+  return active;
+}
+
+void nav_panel_set_connected(bool is_connected) {
+  connected = is_connected;
+  if (!active) return;
+
+  layer_mark_dirty(icon_layer);
+  if (connected) {
+    route_timer_restart();
+  } else if (route_timer) {
+    app_timer_cancel(route_timer);
+    route_timer = NULL;
+  }
+}
+
+Layer *nav_panel_create(GRect frame, NavRouteChanged changed) {
+  Layer *layer = layer_create(frame);
+  route_changed = changed;
+
+  icon_sheet = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_NAV_ICONS);
+  for (int i = 0; i < NUM_NAV_ICONS; i++) {
+    icons[i] = gbitmap_create_as_sub_bitmap(icon_sheet, GRect(i * NAV_ICON_SIZE, 0, NAV_ICON_SIZE, NAV_ICON_SIZE));
+  }
+
+  int16_t top = (frame.size.h - NAV_ICON_SIZE) / 2;
+  icon_layer = layer_create(GRect(6, top, NAV_ICON_SIZE, NAV_ICON_SIZE));
+  layer_set_update_proc(icon_layer, icon_update_proc);
+  layer_add_child(layer, icon_layer);
+
+  text_layer = text_layer_create(GRect(44, -2, frame.size.w - 48, frame.size.h));
+  text_layer_set_text_color(text_layer, GColorWhite);
+  text_layer_set_background_color(text_layer, GColorClear);
+  text_layer_set_font(text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+  text_layer_set_overflow_mode(text_layer, GTextOverflowModeTrailingEllipsis);
+  text_layer_set_text(text_layer, text);
+  layer_add_child(layer, text_layer_get_layer(text_layer));
+
+  return layer;
+}
+
+void nav_panel_destroy(Layer *layer) {
+  if (route_timer) {
+    app_timer_cancel(route_timer);
+    route_timer = NULL;
+  }
+  text_layer_destroy(text_layer);
+  layer_destroy(icon_layer);
+  layer_destroy(layer);
+  for (int i = 0; i < NUM_NAV_ICONS; i++) {
+    gbitmap_destroy(icons[i]);
+  }
+  gbitmap_destroy(icon_sheet);
+}
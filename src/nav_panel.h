@@ -0,0 +1,30 @@
+#pragma once
+#include <pebble.h>
+
+// Maneuver icons in resources/images/nav_icons.png, in the order the phone
+// numbers them on SM_NAV_ICON_KEY.
+typedef enum {
+  NAV_ICON_STRAIGHT,
+  NAV_ICON_SLIGHT_LEFT,
+  NAV_ICON_LEFT,
+  NAV_ICON_SHARP_LEFT,
+  NAV_ICON_SLIGHT_RIGHT,
+  NAV_ICON_RIGHT,
+  NAV_ICON_SHARP_RIGHT,
+  NAV_ICON_U_TURN,
+  NAV_ICON_ROUNDABOUT,
+  NAV_ICON_ARRIVE,
+  NUM_NAV_ICONS
+} NavIcon;
+
+typedef void (*NavRouteChanged)(void);
+
+Layer *nav_panel_create(GRect frame, NavRouteChanged route_changed);
+
+void nav_panel_destroy(Layer *layer);
+
+void nav_panel_received(Tuple *t);
+
+bool nav_panel_active(void);
+
+void nav_panel_set_connected(bool connected);
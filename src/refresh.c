@@ -0,0 +1,138 @@
+#include <pebble.h>
+#include "globals.h"
+#include "refresh.h"
+
+/* Decides how often the phone should push status, and tells it through
+SM_UPDATE_INTERVAL_KEY whenever the answer changes. Starting from
+REFRESH_BASE_INTERVAL, the interval doubles when nobody has tapped or
+pressed a button for a while and again when the last few pushes brought
+nothing new. It drops to REFRESH_MIN_INTERVAL while the phone says music
+is playing or the next calendar event is about to start. A low watch
+battery doubles whatever comes out of that. Recomputed every minute, but
+only sent when it changes, so it costs a message every few hours. */
+
+#define IDLE_AFTER (60 * 60)
+#define UNCHANGED_AFTER 4
+#define EVENT_SOON (30 * 60)
+#define LOW_BATTERY 20
+
+static time_t last_activity, next_event;
+static bool playing;
+
+// The clock as of the last minute tick, which the day simulation drives
+// from its own clock; until the first tick it's the real one.
+
+static time_t clock_now;
+
+static time_t refresh_time(void) {
+  return clock_now ? clock_now : time(NULL);
+}
+static uint8_t unchanged;
+static uint8_t wanted, sent, sending;
+
+void refresh_activity(void) {
+  last_activity = refresh_time();
+}
+
+void refresh_status_received(bool changed) {
+  if (changed) {
+    unchanged = 0;
+  } else if (unchanged < UNCHANGED_AFTER) {
+    unchanged++;
+  }
+}
+
+void refresh_set_playing(bool is_playing) {
+  playing = is_playing;
+}
+
+static bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// The phone sends the event time already formatted. Only a bare "h:mm",
+// with an optional am/pm, is taken to be today; anything with a day or
+// date in it is left alone rather than guessed at.
+
+void refresh_set_calendar(const char *event_time) {
+  const char *p = event_time;
+  next_event = 0;
+
+  while (*p == ' ') p++;
+  if (!is_digit(p[0])) return;
+
+  int hour = *p++ - '0';
+  if (is_digit(*p)) {
+    hour = hour * 10 + (*p++ - '0');
+  }
+  if (p[0] != ':' || p[1] < '0' || p[1] > '5' || !is_digit(p[2])) return;
+  int minute = (p[1] - '0') * 10 + (p[2] - '0');
+  p += 3;
+
+  if (*p == ' ') p++;
+  if ((*p == 'p' || *p == 'P') && (p[1] == 'm' || p[1] == 'M')) {
+    if (hour > 12) return;
+    if (hour < 12) hour += 12;
+    p += 2;
+  } else if ((*p == 'a' || *p == 'A') && (p[1] == 'm' || p[1] == 'M')) {
+    if (hour > 12) return;
+    if (hour == 12) hour = 0;
+    p += 2;
+  }
+  while (*p == ' ') p++;
+  if (*p != '\0' || hour > 23) return;
+
+  time_t now = refresh_time();
+  struct tm event = *localtime(&now);
+  event.tm_hour = hour;
+  event.tm_min = minute;
+  event.tm_sec = 0;
+  next_event = mktime(&event);
+}
+
+void refresh_reconnected(void) {
+  // The phone app may have been restarted with its own setting.
+  sent = 0;
+}
+
+static uint8_t refresh_interval(time_t now) {
+  uint8_t interval = REFRESH_BASE_INTERVAL;
+
+  if (playing || (next_event >= now && next_event - now <= EVENT_SOON)) {
+    interval = REFRESH_MIN_INTERVAL;
+  } else {
+    if (now - last_activity > IDLE_AFTER) interval *= 2;
+    if (unchanged >= UNCHANGED_AFTER) interval *= 2;
+  }
+
+  BatteryChargeState charge = battery_state_service_peek();
+  if (!charge.is_charging && charge.charge_percent <= LOW_BATTERY) interval *= 2;
+
+  return interval > REFRESH_MAX_INTERVAL ? REFRESH_MAX_INTERVAL : interval;
+}
+
+void refresh_update(time_t now) {
+  clock_now = now;
+  wanted = refresh_interval(now);
+  refresh_flush();
+}
+
+void refresh_flush(void) {
+  if (wanted == sent || sending != 0) return;
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return; // Retried once the outbox is free
+
+  dict_write_uint8(iter, SM_UPDATE_INTERVAL_KEY, wanted);
+  if (app_message_outbox_send() != APP_MSG_OK) return;
+
+  sending = wanted;
+}
+
+void refresh_outbox_result(bool delivered) {
+  if (sending != 0 && delivered) {
+    sent = sending;
+  }
+  sending = 0;
+  refresh_flush();
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <pebble.h>
+
+// Status push intervals asked of the phone, in minutes.
+#define REFRESH_MIN_INTERVAL 5
+#define REFRESH_BASE_INTERVAL 15
+#define REFRESH_MAX_INTERVAL 60
+
+void refresh_activity(void);
+
+void refresh_status_received(bool changed);
+
+void refresh_set_playing(bool is_playing);
+
+void refresh_set_calendar(const char *event_time);
+
+void refresh_reconnected(void);
+
+// Called every minute with the time of the tick.
+void refresh_update(time_t now);
+
+void refresh_flush(void);
+
+void refresh_outbox_result(bool delivered);
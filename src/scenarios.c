@@ -0,0 +1,148 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+#include "scenarios.h"
+
+#ifdef WIZARD_SCENARIOS
+
+/* Puts the face through a fixed set of scenes for tools/golden_frames.py.
+Each step sets up its scene, waits for animations to settle, then logs
+
+  frame <name>: <ms> ms, <n> redraws
+
+with the time of the last full redraw, and how many redraws the scene
+took. The tool takes a screenshot when it sees the line and compares it
+to tools/golden/<name>.png. The clock, batteries and status are fixed,
+and neither AppMessage nor the battery service is subscribed so nothing
+else can change them, so the
+frames come out the same every run; battery estimates depend on the
+history kept on the watch, so the tap overlay isn't one of the scenes. */
+
+#define SCENARIO_SETTLE_MS 1000
+#define SCENARIO_STEP_MS 5000
+
+void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed);
+void inbox_received_callback(DictionaryIterator *received, void *context);
+void batteryChanged(BatteryChargeState batt);
+void notification(int image, int vibration);
+void carousel_slide(int next_layer, int direction);
+
+static void send_status(void) {
+  static const uint8_t graph[] = { 40, 2, 3, -1, 4, -2, -3, 5, 1, 6, -4, 2 };
+  uint8_t buffer[320];
+  DictionaryIterator iter;
+
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, SM_WEATHER_TEMP_KEY, "18°");
+  dict_write_uint8(&iter, SM_WEATHER_ICON_KEY, 1);
+  dict_write_cstring(&iter, SM_COUNT_PHONE_KEY, "1");
+  dict_write_cstring(&iter, SM_COUNT_SMS_KEY, "3");
+  dict_write_cstring(&iter, SM_COUNT_MAIL_KEY, "12");
+  dict_write_uint8(&iter, SM_COUNT_BATTERY_KEY, 80);
+  dict_write_cstring(&iter, SM_STATUS_CAL_TIME_KEY, "11:30 AM");
+  dict_write_cstring(&iter, SM_STATUS_CAL_TEXT_KEY, "Design review");
+  dict_write_cstring(&iter, SM_STATUS_MUS_ARTIST_KEY, "Artist");
+  dict_write_cstring(&iter, SM_STATUS_MUS_TITLE_KEY, "Title");
+  dict_write_cstring(&iter, SM_STOCKS_TITLE_KEY, "AAPL");
+  dict_write_cstring(&iter, SM_STOCKS_CURR_KEY, "97.67");
+  dict_write_cstring(&iter, SM_STOCKS_LOW_KEY, "96.01");
+  dict_write_cstring(&iter, SM_STOCKS_HIGH_KEY, "98.25");
+  dict_write_data(&iter, SM_STOCKS_GRAPH_KEY, graph, sizeof(graph));
+  dict_write_cstring(&iter, SM_BITCOIN_TITLE_KEY, "BTC");
+  dict_write_cstring(&iter, SM_BITCOIN_CURR_KEY, "383.10");
+  dict_write_cstring(&iter, SM_BITCOIN_LOW_KEY, "378.50");
+  dict_write_cstring(&iter, SM_BITCOIN_HIGH_KEY, "391.00");
+  dict_write_data(&iter, SM_BITCOIN_GRAPH_KEY, graph, sizeof(graph));
+  uint32_t size = dict_write_end(&iter);
+
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received_callback(&iter, NULL);
+}
+
+static void send_phone_battery(uint8_t percent) {
+  uint8_t buffer[16];
+  DictionaryIterator iter;
+
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint8(&iter, SM_COUNT_BATTERY_KEY, percent);
+  uint32_t size = dict_write_end(&iter);
+
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received_callback(&iter, NULL);
+}
+
+static void scene_status(void) {
+  struct tm tick_time = { .tm_year = 114, .tm_mon = 9, .tm_mday = 18, .tm_wday = 6, .tm_hour = 10, .tm_min = 9 };
+  handle_minute_tick(&tick_time, MINUTE_UNIT);
+  batteryChanged((BatteryChargeState){ .charge_percent = 70 });
+  send_status();
+}
+
+static void scene_phone_battery_low(void) {
+  send_phone_battery(5);
+}
+
+static void scene_watch_charging(void) {
+  send_phone_battery(80);
+  batteryChanged((BatteryChargeState){ .charge_percent = 40, .is_charging = true, .is_plugged = true });
+}
+
+static void scene_notification(void) {
+  notification(1, 0);
+}
+
+// The carousel starts on the weather panel and goes once round.
+
+static void scene_carousel(void) {
+  static int panel = WEATHER_LAYER;
+  panel = (panel + 1) % NUM_LAYERS;
+  carousel_slide(panel, 1);
+}
+
+typedef struct {
+  const char *name;
+  void (*setup)(void);
+} Scene;
+
+static const Scene scenes[] = {
+  { "status", scene_status },
+  { "phone-battery-low", scene_phone_battery_low },
+  { "watch-charging", scene_watch_charging },
+  { "notification", scene_notification },
+  { "calendar", scene_carousel },
+  { "music", scene_carousel },
+  { "stocks", scene_carousel },
+  { "bitcoin", scene_carousel },
+  { "weather", scene_carousel },
+};
+
+static uint8_t scene;
+static uint32_t redraws;
+
+static void scene_settled(void *data) {
+  uint32_t scene_redraws = diagnostics.redraws - redraws;
+
+  APP_LOG(APP_LOG_LEVEL_INFO, "frame %s: %u ms, %lu redraws",
+      scenes[scene].name, diagnostics.last_frame_ms, (unsigned long)scene_redraws);
+  scene++;
+}
+
+static void scene_run(void *data) {
+  if (scene == ARRAY_LENGTH(scenes)) {
+    diagnostics_log();
+    APP_LOG(APP_LOG_LEVEL_INFO, "scenarios done");
+    return;
+  }
+
+  redraws = diagnostics.redraws;
+  scenes[scene].setup();
+  app_timer_register(SCENARIO_SETTLE_MS, scene_settled, NULL);
+  app_timer_register(SCENARIO_STEP_MS, scene_run, NULL);
+}
+
+void scenarios_start(void) {
+  scene = 0;
+  app_timer_register(SCENARIO_STEP_MS, scene_run, NULL);
+}
+
+#endif
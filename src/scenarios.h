@@ -0,0 +1,6 @@
+#pragma once
+#include <pebble.h>
+
+// Only built with WIZARD_SCENARIOS=1 pebble build
+
+void scenarios_start(void);
@@ -0,0 +1,135 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+#include "simulation.h"
+
+#ifdef WIZARD_SIMULATE_DAY
+
+/* Runs Wizard through a scripted day on a simulated clock and logs the
+power budget at the end. The minute tick is driven from here instead of
+the tick timer service, and each simulated minute passes in
+SIMULATION_MINUTE_MS of real time, so a day takes six minutes in the
+emulator. The refresh interval logic takes its clock from the tick, so it
+sees the simulated day too. App timers (notification overlays, tap resets) still run in
+real time; they overlap more than on a real wrist, but are counted the
+same. */
+
+#define SIMULATION_MINUTE_MS 250
+#define SIMULATION_MINUTES (24 * 60)
+#define STATUS_PUSH_INTERVAL 15
+
+void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed);
+void inbox_received_callback(DictionaryIterator *received, void *context);
+void tap_handler(AccelAxisType axis, int32_t direction);
+void bluetoothChanged(bool connected);
+void carousel_slide(int next_layer, int direction);
+void up_click_handler(ClickRecognizerRef recognizer, void *context);
+void down_click_handler(ClickRecognizerRef recognizer, void *context);
+
+typedef enum {SIM_TAP, SIM_DISCONNECT, SIM_CONNECT, SIM_UP, SIM_NEXT_SCREEN, SIM_DOWN} SimulationEvent;
+
+typedef struct {
+  uint16_t minute;
+  uint8_t event;
+} ScriptEntry;
+
+// Must be in order of minute
+static const ScriptEntry script[] = {
+  { 7 * 60,       SIM_TAP },         // Wake up, check the battery
+  { 7 * 60 + 1,   SIM_NEXT_SCREEN }, // Calendar
+  { 7 * 60 + 2,   SIM_NEXT_SCREEN }, // Music
+  { 7 * 60 + 30,  SIM_DOWN },        // Refresh before leaving
+  { 8 * 60 + 15,  SIM_DISCONNECT },  // Phone left in the car
+  { 8 * 60 + 40,  SIM_CONNECT },
+  { 10 * 60,      SIM_TAP },
+  { 12 * 60 + 30, SIM_NEXT_SCREEN }, // Stocks and bitcoin at lunch
+  { 12 * 60 + 31, SIM_NEXT_SCREEN },
+  { 12 * 60 + 32, SIM_NEXT_SCREEN }, // Back to weather
+  { 13 * 60,      SIM_UP },          // Siri
+  { 15 * 60,      SIM_TAP },
+  { 17 * 60 + 45, SIM_DISCONNECT },  // Short dropout on the way home
+  { 17 * 60 + 47, SIM_CONNECT },
+  { 18 * 60,      SIM_NEXT_SCREEN },
+  { 18 * 60 + 1,  SIM_NEXT_SCREEN },
+  { 20 * 60,      SIM_TAP },
+  { 22 * 60 + 30, SIM_DOWN },
+};
+
+static uint16_t minute;
+static int panel;
+static uint8_t next_entry;
+static bool connected;
+
+// Builds the status message the phone would push and hands it to the inbox
+// as if it had arrived over bluetooth.
+
+static void push_status(void) {
+  uint8_t buffer[96];
+  char mail[4], sms[4];
+  DictionaryIterator iter;
+
+  snprintf(mail, sizeof(mail), "%d", minute / 90);
+  snprintf(sms, sizeof(sms), "%d", minute / 240);
+
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, SM_COUNT_MAIL_KEY, mail);
+  dict_write_cstring(&iter, SM_COUNT_SMS_KEY, sms);
+  dict_write_uint8(&iter, SM_COUNT_BATTERY_KEY, 100 - minute / 24);
+  dict_write_cstring(&iter, SM_WEATHER_TEMP_KEY, minute < 12 * 60 ? "11°" : "17°");
+  uint32_t size = dict_write_end(&iter);
+
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received_callback(&iter, NULL);
+}
+
+static void run_event(SimulationEvent event) {
+  switch (event) {
+    case SIM_TAP: tap_handler(ACCEL_AXIS_Z, 1); break;
+    case SIM_DISCONNECT: connected = false; bluetoothChanged(false); break;
+    case SIM_CONNECT: connected = true; bluetoothChanged(true); break;
+    case SIM_UP: up_click_handler(NULL, NULL); break;
+    case SIM_NEXT_SCREEN:
+
+      // Straight to the carousel; select on the music panel would enter
+      // volume mode instead of moving on.
+
+      panel = (panel + 1) % NUM_LAYERS;
+      carousel_slide(panel, 1);
+    break;
+    case SIM_DOWN: down_click_handler(NULL, NULL); break;
+  }
+}
+
+static void simulation_step(void *data) {
+  time_t now = time(NULL);
+  struct tm tick_time = *localtime(&now);
+  tick_time.tm_hour = minute / 60;
+  tick_time.tm_min = minute % 60;
+  handle_minute_tick(&tick_time, MINUTE_UNIT);
+
+  while (next_entry < ARRAY_LENGTH(script) && script[next_entry].minute == minute) {
+    run_event(script[next_entry++].event);
+  }
+  if (connected && minute % STATUS_PUSH_INTERVAL == 0) {
+    push_status();
+  }
+
+  // Not counted; these wakeups only exist in the simulation
+  if (++minute < SIMULATION_MINUTES) {
+    app_timer_register(SIMULATION_MINUTE_MS, simulation_step, NULL);
+  } else {
+    diagnostics_budget_log(SIMULATION_MINUTES * 60);
+  }
+}
+
+void simulation_start(void) {
+  memset(&diagnostics, 0, sizeof(diagnostics));
+  diagnostics.started = time(NULL);
+  minute = 0;
+  next_entry = 0;
+  panel = WEATHER_LAYER;
+  connected = true;
+  app_timer_register(SIMULATION_MINUTE_MS, simulation_step, NULL);
+}
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+#include <pebble.h>
+
+// Only built with WIZARD_SIMULATE_DAY=1 pebble build
+
+void simulation_start(void);
@@ -0,0 +1,109 @@
+#include <pebble.h>
+#include "diagnostics.h"
+#include "sparkline.h"
+
+/* A series arrives as one byte array: the first byte is the starting
+value and every byte after it is a signed step from the previous point.
+It's kept in that form, since it's the smallest we'll get it, and drawn
+once into a cached bitmap; the update proc only ever blits the cache. */
+
+typedef struct {
+  GBitmap *cache;
+  uint8_t length;
+  uint8_t series[SPARKLINE_MAX_POINTS];
+} Sparkline;
+
+static void set_pixel(GBitmap *bitmap, int x, int y) {
+  uint8_t *data = bitmap->addr;
+  data[y * bitmap->row_size_bytes + (x >> 3)] |= 1 << (x & 7);
+}
+
+// Bresenham, so the whole graph is drawn with integer adds and compares.
+
+static void draw_line(GBitmap *bitmap, int x0, int y0, int x1, int y1) {
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+
+  for (;;) {
+    set_pixel(bitmap, x0, y0);
+    if (x0 == x1 && y0 == y1) break;
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+static void render(Sparkline *sparkline) {
+  GBitmap *bitmap = sparkline->cache;
+  if (bitmap == NULL) return;
+
+  int width = bitmap->bounds.size.w, height = bitmap->bounds.size.h;
+  int value, min, max;
+
+  memset(bitmap->addr, 0, bitmap->row_size_bytes * height);
+  if (sparkline->length < 2) return;
+
+  value = min = max = sparkline->series[0];
+  for (int i = 1; i < sparkline->length; i++) {
+    value += (int8_t)sparkline->series[i];
+    if (value < min) min = value;
+    if (value > max) max = value;
+  }
+
+  int range = max > min ? max - min : 1;
+  int last = sparkline->length - 1;
+  int x0 = 0, y0 = 0;
+
+  value = sparkline->series[0];
+  for (int i = 0; i <= last; i++) {
+    if (i > 0) value += (int8_t)sparkline->series[i];
+    int x = i * (width - 1) / last;
+    int y = (height - 1) - (value - min) * (height - 1) / range;
+    if (i > 0) draw_line(bitmap, x0, y0, x, y);
+    x0 = x;
+    y0 = y;
+  }
+}
+
+static void sparkline_update_proc(Layer *layer, GContext *ctx) {
+  PROFILE_BEGIN(PROFILE_SPARKLINE);
+  Sparkline *sparkline = layer_get_data(layer);
+  graphics_context_set_compositing_mode(ctx, GCompOpOr);
+  graphics_draw_bitmap_in_rect(ctx, sparkline->cache, layer_get_bounds(layer));
+  PROFILE_END(PROFILE_SPARKLINE);
+}
+
+Layer *sparkline_layer_create(GRect frame) {
+  Layer *layer = layer_create_with_data(frame, sizeof(Sparkline));
+  Sparkline *sparkline = layer_get_data(layer);
+
+  sparkline->cache = gbitmap_create_blank(frame.size);
+  sparkline->length = 0;
+
+  // Out of memory; the panel just goes without its graph.
+  if (sparkline->cache == NULL) return layer;
+
+  layer_set_update_proc(layer, sparkline_update_proc);
+  return layer;
+}
+
+void sparkline_layer_destroy(Layer *layer) {
+  Sparkline *sparkline = layer_get_data(layer);
+  if (sparkline->cache) {
+    gbitmap_destroy(sparkline->cache);
+  }
+  layer_destroy(layer);
+}
+
+void sparkline_layer_set_series(Layer *layer, const uint8_t *data, uint16_t length) {
+  Sparkline *sparkline = layer_get_data(layer);
+
+  if (length > SPARKLINE_MAX_POINTS) length = SPARKLINE_MAX_POINTS;
+  if (length == sparkline->length && memcmp(sparkline->series, data, length) == 0) return;
+
+  memcpy(sparkline->series, data, length);
+  sparkline->length = length;
+  render(sparkline);
+  layer_mark_dirty(layer);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <pebble.h>
+
+#define SPARKLINE_MAX_POINTS 96
+
+Layer *sparkline_layer_create(GRect frame);
+
+void sparkline_layer_destroy(Layer *layer);
+
+void sparkline_layer_set_series(Layer *layer, const uint8_t *data, uint16_t length);
@@ -0,0 +1,26 @@
+#pragma once
+
+// Persistent storage shared between the app and the background worker.
+
+#define PERSIST_STATUS_KEY    1 // StatusCache, written by the app on exit
+#define PERSIST_WORKER_KEY    2 // WorkerState, written by the worker
+#define PERSIST_WATCH_BATTERY_KEY 3 // BatteryHistory, written by the app on exit
+#define PERSIST_PHONE_BATTERY_KEY 4
+
+#define STATUS_CACHE_VERSION  1
+#define STATUS_CACHE_MAX_AGE  (30 * 60)
+
+typedef struct {
+  uint8_t version;
+  uint8_t phone_battery;
+  uint8_t weather_icon;
+  time_t updated;
+  char weather_temp[6];
+  char sms_count[5], mail_count[5], phone_count[5];
+  char calendar_date[64], calendar_text[64];
+} StatusCache;
+
+typedef struct {
+  bool connected;
+  time_t connection_changed;
+} WorkerState;
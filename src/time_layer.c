@@ -0,0 +1,155 @@
+#include <pebble.h>
+#include "time_layer.h"
+
+/* The clock is drawn from a sprite sheet of its eleven glyphs, rasterized
+from the font ahead of time (see tools/glyph_sheet.py), so there's no font
+to load and no text layout each minute. The window is redrawn as a whole
+whenever any layer is dirty, so the digits are all drawn from one update
+proc. If the sheet can't be loaded the clock falls back to a system font. */
+
+#define NUM_GLYPHS 11 // ':' then '0' to '9'
+
+typedef struct {
+  TextLayer *fallback;
+  char text[TIME_LAYER_LENGTH + 1];
+} TimeLayer;
+
+// There's only the one clock, so the sheet is shared.
+
+static uint8_t *sheet_data;
+static GBitmap *sheet;
+static GBitmap *glyphs[NUM_GLYPHS];
+static int16_t widths[NUM_GLYPHS];
+static int16_t glyph_height;
+
+static int glyph_index(char c) {
+  if (c == ':') return 0;
+  if (c >= '0' && c <= '9') return c - '0' + 1;
+  return -1;
+}
+
+static void sheet_unload(void) {
+  for (int i = 0; i < NUM_GLYPHS; i++) {
+    if (glyphs[i]) gbitmap_destroy(glyphs[i]);
+    glyphs[i] = NULL;
+  }
+  if (sheet) gbitmap_destroy(sheet);
+  sheet = NULL;
+  free(sheet_data);
+  sheet_data = NULL;
+}
+
+static bool sheet_load(void) {
+  ResHandle handle = resource_get_handle(RESOURCE_ID_TIME_DIGITS);
+  size_t size = resource_size(handle);
+
+  if (size < 12) return false;
+
+  sheet_data = malloc(size);
+  if (!sheet_data) return false;
+  if (resource_load(handle, sheet_data, size) != size) {
+    sheet_unload();
+    return false;
+  }
+
+  // The glyph edges follow the pixels, which start after the 12 byte header.
+
+  uint16_t row_size_bytes, edges[NUM_GLYPHS + 1];
+  memcpy(&row_size_bytes, sheet_data, sizeof(row_size_bytes));
+  memcpy(&glyph_height, sheet_data + 10, sizeof(glyph_height));
+
+  size_t edges_at = 12 + row_size_bytes * glyph_height;
+  if (edges_at + sizeof(edges) > size) {
+    sheet_unload();
+    return false;
+  }
+  memcpy(edges, sheet_data + edges_at, sizeof(edges));
+
+  sheet = gbitmap_create_with_data(sheet_data);
+  if (!sheet) {
+    sheet_unload();
+    return false;
+  }
+
+  for (int i = 0; i < NUM_GLYPHS; i++) {
+    widths[i] = edges[i + 1] - edges[i];
+    glyphs[i] = gbitmap_create_as_sub_bitmap(sheet, GRect(edges[i], 0, widths[i], glyph_height));
+    if (!glyphs[i]) {
+      sheet_unload();
+      return false;
+    }
+  }
+  return true;
+}
+
+static void time_layer_update_proc(Layer *layer, GContext *ctx) {
+  TimeLayer *time_layer = layer_get_data(layer);
+  int16_t width = 0;
+
+  for (char *c = time_layer->text; *c; c++) {
+    width += widths[glyph_index(*c)];
+  }
+
+  // Centred like the text layer it replaces
+
+  int16_t x = (layer_get_bounds(layer).size.w - width) / 2;
+
+  graphics_context_set_compositing_mode(ctx, GCompOpOr);
+  for (char *c = time_layer->text; *c; c++) {
+    int glyph = glyph_index(*c);
+    graphics_draw_bitmap_in_rect(ctx, glyphs[glyph], GRect(x, 0, widths[glyph], glyph_height));
+    x += widths[glyph];
+  }
+}
+
+Layer *time_layer_create(GRect frame) {
+  Layer *layer = layer_create_with_data(frame, sizeof(TimeLayer));
+  TimeLayer *time_layer = layer_get_data(layer);
+
+  time_layer->text[0] = '\0';
+  time_layer->fallback = NULL;
+
+  if (sheet_load()) {
+    layer_set_update_proc(layer, time_layer_update_proc);
+  } else {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "time digits not loaded, using the system font");
+    time_layer->fallback = text_layer_create(GRect(0, 0, frame.size.w, frame.size.h));
+    text_layer_set_text_alignment(time_layer->fallback, GTextAlignmentCenter);
+    text_layer_set_text_color(time_layer->fallback, GColorWhite);
+    text_layer_set_background_color(time_layer->fallback, GColorClear);
+    text_layer_set_font(time_layer->fallback, fonts_get_system_font(FONT_KEY_BITHAM_42_BOLD));
+    text_layer_set_text(time_layer->fallback, time_layer->text);
+    layer_add_child(layer, text_layer_get_layer(time_layer->fallback));
+  }
+
+  return layer;
+}
+
+void time_layer_destroy(Layer *layer) {
+  TimeLayer *time_layer = layer_get_data(layer);
+
+  if (time_layer->fallback) {
+    text_layer_destroy(time_layer->fallback);
+  }
+  layer_destroy(layer);
+  sheet_unload();
+}
+
+void time_layer_set_text(Layer *layer, const char *text) {
+  TimeLayer *time_layer = layer_get_data(layer);
+  int length = 0;
+
+  while (length < TIME_LAYER_LENGTH && glyph_index(text[length]) >= 0) {
+    length++;
+  }
+  if (strncmp(time_layer->text, text, length) == 0 && time_layer->text[length] == '\0') return;
+
+  memcpy(time_layer->text, text, length);
+  time_layer->text[length] = '\0';
+
+  if (time_layer->fallback) {
+    text_layer_set_text(time_layer->fallback, time_layer->text);
+  } else {
+    layer_mark_dirty(layer);
+  }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <pebble.h>
+
+// Longest time shown, "00:00"
+#define TIME_LAYER_LENGTH 5
+
+Layer *time_layer_create(GRect frame);
+
+void time_layer_destroy(Layer *layer);
+
+void time_layer_set_text(Layer *layer, const char *text);
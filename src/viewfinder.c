@@ -0,0 +1,358 @@
+#include <pebble.h>
+#include "globals.h"
+#include "diagnostics.h"
+#include "viewfinder.h"
+
+// WIZARD_VIEWFINDER_BENCHMARK=1 pebble build feeds the viewfinder from a
+// local frame source instead of the phone, for measuring decode throughput
+// in the emulator.
+
+/* Frames are 144x168 at 1 bit per pixel, sent as several SM_STREAMING_BMP_KEY
+byte arrays. Each chunk starts with a four byte header:
+
+  uint8 frame id, uint8 flags, uint16 offset into the decoded frame
+
+followed by its payload. Rows are 18 bytes, least significant bit first.
+With CHUNK_RLE the payload is run-length encoded: a control byte below 0x80
+copies that many plus one literal bytes, otherwise the next byte is repeated
+(control & 0x7F) + 1 times. Runs never cross chunks. With CHUNK_DELTA the
+decoded bytes are XORed onto the previous frame.
+
+Chunks are decoded straight into the back buffer as they arrive, so decoding
+overlaps with the rest of the frame still in transit. As soon as the last
+chunk is in, the next frame is requested, then the buffers are swapped. */
+
+#define FRAME_WIDTH 144
+#define FRAME_HEIGHT 168
+#define FRAME_ROW_BYTES (FRAME_WIDTH / 8)
+#define FRAME_BYTES (FRAME_ROW_BYTES * FRAME_HEIGHT)
+
+#define CHUNK_HEADER 4
+#define CHUNK_RLE    0x01
+#define CHUNK_DELTA  0x02
+#define CHUNK_LAST   0x80
+
+#define FRAME_TIMEOUT 2000
+
+static Window *viewfinder_window;
+static BitmapLayer *frame_layer;
+static TextLayer *stats_layer;
+static GBitmap *frames[2];
+static int front;
+
+static uint8_t frame_id;
+static uint16_t expected_offset;
+static bool frame_broken;
+static uint32_t frame_bytes;
+static AppTimer *frame_timer;
+
+// The camera launch stays pending until the first chunk arrives. It goes
+// out as soon as the outbox is free and again on every frame timeout.
+
+static bool launch_pending, launch_sent, exit_pending;
+
+static uint32_t fps_started_ms;
+static int fps_frames;
+static char stats_text[24];
+
+// FRAME DECODING
+
+typedef struct {
+  uint8_t *back, *front;
+  uint16_t stride;
+  int row, col, offset;
+  bool delta;
+} FrameWriter;
+
+static void writer_put(FrameWriter *w, uint8_t value, int count) {
+  for (; count > 0 && w->offset < FRAME_BYTES; count--, w->offset++) {
+    int pos = w->row * w->stride + w->col;
+    w->back[pos] = w->delta ? value ^ w->front[pos] : value;
+    if (++w->col == FRAME_ROW_BYTES) {
+      w->col = 0;
+      w->row++;
+    }
+  }
+}
+
+static void request_frame(bool key_frame);
+
+static void frame_complete(void) {
+  front = !front;
+  bitmap_layer_set_bitmap(frame_layer, frames[front]);
+
+  uint32_t now = diagnostics_now_ms();
+  uint32_t elapsed = now - fps_started_ms;
+  fps_frames++;
+  if (elapsed >= 1000) {
+    int fps_x10 = fps_frames * 10000 / elapsed;
+    snprintf(stats_text, sizeof(stats_text), "%d.%d fps %lu B", fps_x10 / 10, fps_x10 % 10, (unsigned long)frame_bytes);
+    text_layer_set_text(stats_layer, stats_text);
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "viewfinder: %s", stats_text);
+    fps_started_ms = now;
+    fps_frames = 0;
+  }
+}
+
+// If the last chunk of a frame goes missing nothing would ask for the next
+// one, so start over with a key frame when the stream goes quiet.
+
+static void frame_timed_out(void *data) {
+  if (launch_pending) {
+    launch_sent = false;
+    viewfinder_flush();
+  } else {
+    request_frame(true);
+  }
+  frame_timer = diagnostics_timer_register(FRAME_TIMEOUT, frame_timed_out, NULL);
+}
+
+// The main window's exit message is usually still in flight when we
+// appear, so the launch and exit wait here for the outbox callbacks.
+
+void viewfinder_flush(void) {
+  if (!exit_pending && (!launch_pending || launch_sent)) return;
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return; // Retried once the outbox is free
+
+  if (exit_pending) {
+    dict_write_int8(iter, SM_SCREEN_EXIT_KEY, CAMERA_APP);
+  } else {
+    dict_write_int8(iter, SM_SCREEN_ENTER_KEY, CAMERA_APP);
+    dict_write_int8(iter, SM_LAUNCH_CAMERA_KEY, -1);
+    dict_write_int8(iter, SM_CAMERA_NEXT_FRAME, true);
+  }
+  if (app_message_outbox_send() != APP_MSG_OK) return;
+
+  if (exit_pending) {
+    exit_pending = false;
+  } else {
+    launch_sent = true;
+  }
+}
+
+static void viewfinder_chunk(const uint8_t *data, uint16_t length) {
+  if (viewfinder_window == NULL || length < CHUNK_HEADER) return;
+  launch_pending = false;
+
+  uint8_t flags = data[1];
+  uint16_t offset = data[2] | (data[3] << 8);
+
+  if (frame_timer) {
+    app_timer_reschedule(frame_timer, FRAME_TIMEOUT);
+  }
+
+  // A new id starts a new frame; a gap in the offsets means a chunk went
+  // missing, and the rest of the frame is ignored.
+
+  if (data[0] != frame_id || offset == 0) {
+    frame_id = data[0];
+    frame_broken = offset != 0;
+    frame_bytes = 0;
+  } else if (offset != expected_offset) {
+    frame_broken = true;
+  }
+  frame_bytes += length;
+
+  if (!frame_broken) {
+    FrameWriter w = {
+      .back = frames[!front]->addr,
+      .front = frames[front]->addr,
+      .stride = frames[!front]->row_size_bytes,
+      .row = offset / FRAME_ROW_BYTES,
+      .col = offset % FRAME_ROW_BYTES,
+      .offset = offset,
+      .delta = flags & CHUNK_DELTA
+    };
+    const uint8_t *p = data + CHUNK_HEADER, *end = data + length;
+
+    if (flags & CHUNK_RLE) {
+      while (p < end) {
+        uint8_t control = *p++;
+        if (control & 0x80) {
+          if (p == end) break;
+          writer_put(&w, *p++, (control & 0x7F) + 1);
+        } else {
+          for (int n = control + 1; n > 0 && p < end; n--) {
+            writer_put(&w, *p++, 1);
+          }
+        }
+      }
+    } else {
+      while (p < end) {
+        writer_put(&w, *p++, 1);
+      }
+    }
+    expected_offset = w.offset;
+  }
+
+  if (flags & CHUNK_LAST) {
+
+    // Get the next frame on its way before spending time on this one. A
+    // broken frame leaves nothing for a delta to build on.
+
+    request_frame(frame_broken);
+    if (!frame_broken) {
+      frame_complete();
+    }
+  }
+}
+
+void viewfinder_received(Tuple *t) {
+  if (viewfinder_window == NULL || t->type != TUPLE_BYTE_ARRAY) return;
+  viewfinder_chunk(t->value->data, t->length);
+}
+
+#ifdef WIZARD_VIEWFINDER_BENCHMARK
+
+// LOCAL FRAME SOURCE
+
+/* Draws a moving diagonal stripe pattern, RLE encodes it into chunks the
+size the phone would send and feeds them through the normal decode path. */
+
+#define BENCHMARK_CHUNK 120
+
+static uint8_t benchmark_frame;
+
+static uint8_t benchmark_byte(int offset) {
+  int row = offset / FRAME_ROW_BYTES, col = offset % FRAME_ROW_BYTES;
+  return ((row + col * 8 + benchmark_frame * 4) & 32) ? 0xFF : 0x00;
+}
+
+static void benchmark_send_frame(void *data) {
+  uint8_t chunk[BENCHMARK_CHUNK];
+  int offset = 0;
+
+  if (viewfinder_window == NULL) return;
+
+  benchmark_frame++;
+  while (offset < FRAME_BYTES) {
+    int length = CHUNK_HEADER, chunk_offset = offset;
+
+    while (offset < FRAME_BYTES && length <= BENCHMARK_CHUNK - 2) {
+      uint8_t value = benchmark_byte(offset);
+      int run = 1;
+      while (run < 128 && offset + run < FRAME_BYTES && benchmark_byte(offset + run) == value) run++;
+      chunk[length++] = 0x80 | (run - 1);
+      chunk[length++] = value;
+      offset += run;
+    }
+
+    chunk[0] = benchmark_frame;
+    chunk[1] = CHUNK_RLE | (offset == FRAME_BYTES ? CHUNK_LAST : 0);
+    chunk[2] = chunk_offset & 0xFF;
+    chunk[3] = chunk_offset >> 8;
+    viewfinder_chunk(chunk, length);
+  }
+}
+
+static void request_frame(bool key_frame) {
+  diagnostics_timer_register(1, benchmark_send_frame, NULL);
+}
+
+#else
+
+static void request_frame(bool key_frame) {
+  sendCommandInt(SM_CAMERA_NEXT_FRAME, key_frame);
+}
+
+#endif
+
+// CLICK HANDLERS
+
+static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  sendCommand(SM_CAMERA_SWITCH);
+}
+
+static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  sendCommand(SM_TAKE_PICTURE_KEY);
+}
+
+static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  sendCommand(SM_CAMERA_FLASH);
+}
+
+static void click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+}
+
+// WINDOW HANDLERS
+
+static void window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+
+  frame_layer = bitmap_layer_create(GRect(0, 0, FRAME_WIDTH, FRAME_HEIGHT));
+  bitmap_layer_set_bitmap(frame_layer, frames[front]);
+  layer_add_child(window_layer, bitmap_layer_get_layer(frame_layer));
+
+  stats_layer = text_layer_create(GRect(0, 150, 144, 18));
+  text_layer_set_text_color(stats_layer, GColorWhite);
+  text_layer_set_background_color(stats_layer, GColorBlack);
+  text_layer_set_font(stats_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  layer_add_child(window_layer, text_layer_get_layer(stats_layer));
+}
+
+static void window_appear(Window *window) {
+  fps_started_ms = diagnostics_now_ms();
+  fps_frames = 0;
+  frame_timer = diagnostics_timer_register(FRAME_TIMEOUT, frame_timed_out, NULL);
+
+#ifdef WIZARD_VIEWFINDER_BENCHMARK
+  request_frame(true);
+#else
+  launch_pending = true;
+  launch_sent = false;
+  exit_pending = false;
+  viewfinder_flush();
+#endif
+}
+
+static void window_disappear(Window *window) {
+  app_timer_cancel(frame_timer);
+  frame_timer = NULL;
+
+  // No need to leave a screen the phone was never told about.
+
+  exit_pending = !launch_pending || launch_sent;
+  launch_pending = false;
+  viewfinder_flush();
+}
+
+// Frame buffers are only held while the viewfinder is open.
+
+static void window_unload(Window *window) {
+  text_layer_destroy(stats_layer);
+  bitmap_layer_destroy(frame_layer);
+  gbitmap_destroy(frames[0]);
+  gbitmap_destroy(frames[1]);
+  window_destroy(viewfinder_window);
+  viewfinder_window = NULL;
+}
+
+void viewfinder_show(void) {
+  if (viewfinder_window) return;
+
+  frames[0] = gbitmap_create_blank(GSize(FRAME_WIDTH, FRAME_HEIGHT));
+  frames[1] = gbitmap_create_blank(GSize(FRAME_WIDTH, FRAME_HEIGHT));
+  if (frames[0] == NULL || frames[1] == NULL) {
+    if (frames[0]) gbitmap_destroy(frames[0]);
+    if (frames[1]) gbitmap_destroy(frames[1]);
+    return;
+  }
+  front = 0;
+  frame_broken = true;
+
+  viewfinder_window = window_create();
+  window_set_fullscreen(viewfinder_window, true);
+  window_set_click_config_provider(viewfinder_window, click_config_provider);
+  window_set_window_handlers(viewfinder_window, (WindowHandlers) {
+       .load = window_load,
+     .unload = window_unload,
+     .appear = window_appear,
+  .disappear = window_disappear
+  });
+  window_stack_push(viewfinder_window, true);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <pebble.h>
+
+void viewfinder_show(void);
+
+void viewfinder_received(Tuple *t);
+
+void viewfinder_flush(void);
@@ -0,0 +1,79 @@
+#include <pebble.h>
+#include "globals.h"
+#include "volume.h"
+
+/* Volume presses are queued and go out as the outbox frees up, one step
+per message just like the phone has always received them (-1 on
+SM_VOLUME_UP_KEY or SM_VOLUME_DOWN_KEY). Holding a button piles steps up
+in `pending` rather than failing sends; the pile is capped at what it
+takes to get from one end of the range to the other, so letting go stops
+the volume soon after. The displayed value is the last value the phone
+reported plus every step it hasn't reported back yet. The request for the
+current value waits in the same queue, ahead of any steps. */
+
+#define VOLUME_MAX_PENDING ((100 + VOLUME_STEP - 1) / VOLUME_STEP)
+
+static int confirmed = -1; // Unknown until the phone reports it
+static int pending, in_flight, sending;
+static bool request_pending, requesting;
+
+void volume_flush(void) {
+  if (sending != 0 || requesting) return;
+  if (pending == 0 && !request_pending) return;
+
+  DictionaryIterator *iter;
+  if (sm_message_out_get(&iter) != APP_MSG_OK) return; // Retried once the outbox is free
+
+  if (request_pending) {
+    dict_write_int8(iter, SM_VOLUME_VALUE_KEY, -1);
+    if (app_message_outbox_send() != APP_MSG_OK) return;
+    request_pending = false;
+    requesting = true;
+    return;
+  }
+
+  int step = pending > 0 ? 1 : -1;
+  dict_write_int8(iter, step > 0 ? SM_VOLUME_UP_KEY : SM_VOLUME_DOWN_KEY, -1);
+  if (app_message_outbox_send() != APP_MSG_OK) return;
+
+  sending = step;
+  in_flight += step;
+  pending -= step;
+}
+
+void volume_change(int steps) {
+  pending += steps;
+  if (pending > VOLUME_MAX_PENDING) pending = VOLUME_MAX_PENDING;
+  if (pending < -VOLUME_MAX_PENDING) pending = -VOLUME_MAX_PENDING;
+  volume_flush();
+}
+
+void volume_request(void) {
+  request_pending = true;
+  volume_flush();
+}
+
+void volume_outbox_result(bool delivered) {
+  if (!delivered) {
+    in_flight -= sending;
+    pending += sending;
+    request_pending = request_pending || requesting;
+  }
+  sending = 0;
+  requesting = false;
+  volume_flush();
+}
+
+void volume_set_confirmed(int value) {
+  confirmed = value;
+  in_flight = sending;
+}
+
+int volume_get(void) {
+  if (confirmed < 0) return -1;
+
+  int value = confirmed + (in_flight + pending) * VOLUME_STEP;
+  if (value < 0) return 0;
+  if (value > 100) return 100;
+  return value;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <pebble.h>
+
+// Percentage points the phone moves per volume step.
+#define VOLUME_STEP 6
+
+void volume_change(int steps);
+
+void volume_flush(void);
+
+void volume_request(void);
+
+void volume_outbox_result(bool delivered);
+
+void volume_set_confirmed(int value);
+
+int volume_get(void);
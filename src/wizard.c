@@ -1,27 +1,54 @@
 #include <pebble.h>
 #include "globals.h"
 #include "localize.h"
+#include "diagnostics.h"
+#include "volume.h"
+#include "list_view.h"
+#include "viewfinder.h"
+#include "sparkline.h"
+#include "battery_estimate.h"
+#include "status_cache.h"
+#include "simulation.h"
+#include "refresh.h"
+#include "time_layer.h"
+#include "scenarios.h"
+#include "nav_panel.h"
 
 static Window *window;
 
 #define STRING_LENGTH 255
 #define NUM_ICON_IMAGES	7
 
-typedef enum {WEATHER_LAYER, CALENDAR_LAYER, MUSIC_LAYER, NUM_LAYERS} AnimatedLayers;
-
 static PropertyAnimation *ani_out, *ani_in;
 
 static TextLayer *text_weather_cond_layer, *text_weather_temp_layer;
-static TextLayer *text_date_layer, *text_time_layer;
+static TextLayer *text_date_layer;
+static Layer *time_layer;
 static TextLayer *text_mail_layer, *text_sms_layer, *text_phone_layer;
 static TextLayer *calendar_date_layer, *calendar_text_layer;
 static TextLayer *music_artist_layer, *music_song_layer;
 static TextLayer *text_battery_layer, *text_pebble_battery_layer;
+static TextLayer *text_battery_estimate_layer, *text_pebble_battery_estimate_layer;
 
 static Layer *battery_info_layer, *battery_layer, *pebble_battery_layer;
-static Layer *mail_layer, *sms_layer, *phone_layer, *message_layer, *animated_layer[4];
+static Layer *volume_layer, *redraw_counter_layer, *frame_start_layer, *nav_layer;
+static Layer *mail_layer, *sms_layer, *phone_layer, *message_layer, *animated_layer[NUM_LAYERS];
 
 static BitmapLayer *background_image, *icon_image;
+
+// Fields are in the same order as their SM_*_LOW_KEY to SM_*_TITLE_KEY keys.
+
+typedef enum {GRAPH_LOW, GRAPH_HIGH, GRAPH_CURR, GRAPH_TITLE, NUM_GRAPH_TEXTS, GRAPH_SERIES = NUM_GRAPH_TEXTS} GraphFields;
+
+typedef struct {
+  Layer *graph_layer;
+  TextLayer *text_layers[NUM_GRAPH_TEXTS];
+  char text[NUM_GRAPH_TEXTS][16];
+} GraphPanel;
+
+typedef enum {STOCKS_GRAPH, BITCOIN_GRAPH, NUM_GRAPHS} GraphPanels;
+
+static GraphPanel graph_panels[NUM_GRAPHS];
 GBitmap *bg_image;
 GBitmap *icon_imgs[NUM_ICON_IMAGES];
 
@@ -31,8 +58,12 @@ static char string_buffer[STRING_LENGTH];
 static char pebble_buffer[STRING_LENGTH];
 static char calendar_date_str[STRING_LENGTH], calendar_text_str[STRING_LENGTH];
 static char music_artist_str[STRING_LENGTH], music_title_str[STRING_LENGTH];
+static char battery_estimate_str[6], pebble_battery_estimate_str[6];
 static char weather_temp_str[6], sms_count_str[5], mail_count_str[5], phone_count_str[5];
 static int icon_img, batteryPercent, batteryPblPercent, active_layer;
+static uint8_t weather_icon = 0xFF;
+static BatteryHistory battery_history, pebble_battery_history;
+static time_t status_updated;
 
 const int ICON_IMG_IDS[] = {
   RESOURCE_ID_IMAGE_ICON_SIRI,
@@ -48,7 +79,12 @@ static uint32_t s_sequence_number = 0xFFFFFFFE;
 
 AppMessageResult sm_message_out_get(DictionaryIterator **iter_out) {
   AppMessageResult result = app_message_outbox_begin(iter_out);
-  if(result != APP_MSG_OK) return result;
+  if(result != APP_MSG_OK) {
+    *iter_out = NULL;
+    return result;
+  }
+  diagnostics.messages_sent++;
+  diagnostics_latency_sent();
   dict_write_int32(*iter_out, SM_SEQUENCE_NUMBER_KEY, ++s_sequence_number);
   if(s_sequence_number == 0xFFFFFFFF) {
     s_sequence_number = 1;
@@ -56,6 +92,42 @@ AppMessageResult sm_message_out_get(DictionaryIterator **iter_out) {
   return APP_MSG_OK;
 }
 
+/* Inbound messages carry the phone's own sequence number. Anything at or
+behind the last accepted number is a retransmit or a late frame, so it's
+dropped before it can overwrite newer data. A jump further back than the
+window means the phone restarted its counter, so we accept and resync. */
+
+#define SEQUENCE_WINDOW 64
+
+static uint32_t s_inbound_sequence_number = 0;
+
+bool sm_message_in_accept(DictionaryIterator *received) {
+  Tuple *t = dict_find(received, SM_SEQUENCE_NUMBER_KEY);
+  if (t == NULL || t->length != sizeof(uint32_t)) return true;
+
+  uint32_t sequence_number = t->value->uint32;
+  if (sequence_number == 0xFFFFFFFF) {
+    s_inbound_sequence_number = 0;
+    return true;
+  }
+
+  if (s_inbound_sequence_number != 0) {
+    int32_t delta = (int32_t)(sequence_number - s_inbound_sequence_number);
+    if (delta == 0) {
+      diagnostics.inbox_duplicates++;
+      return false;
+    }
+    if (delta < 0 && delta > -SEQUENCE_WINDOW) {
+      diagnostics.inbox_stale++;
+      return false;
+    }
+  }
+
+  s_inbound_sequence_number = sequence_number;
+  diagnostics.inbox_accepted++;
+  return true;
+}
+
 /* We can't include ctype.h in Pebble projects (that I'm aware of),
 so we're using this to convert the case on our localized date strings. */
 
@@ -78,11 +150,34 @@ char* date_case(char* text) {
   }
 }
 
+// Hides or shows whatever fills the panel area: directions while a route
+// is active, the carousel otherwise.
+
+void panels_set_hidden(bool hidden) {
+  bool route = nav_panel_active();
+  for (int i = 0; i < NUM_LAYERS; i++) {
+    layer_set_hidden(animated_layer[i], hidden || route);
+  }
+  layer_set_hidden(nav_layer, hidden || !route);
+}
+
+void volume_mode_exit(bool advance);
+
+void nav_route_changed(void) {
+
+  // Volume mode draws over the music panel, which directions now cover.
+
+  if (nav_panel_active()) {
+    volume_mode_exit(false);
+  }
+  if (layer_get_hidden(message_layer)) {
+    panels_set_hidden(false);
+  }
+}
+
 void reset() {
   if (bluetooth_connection_service_peek() == 1) {
-    layer_set_hidden(animated_layer[WEATHER_LAYER], false);
-    layer_set_hidden(animated_layer[MUSIC_LAYER], false);
-    layer_set_hidden(animated_layer[CALENDAR_LAYER], false);
+    panels_set_hidden(false);
     layer_set_hidden(message_layer, true);
   }
   layer_set_hidden(battery_info_layer, true);
@@ -95,6 +190,7 @@ void reset_sequence_number() {
   DictionaryIterator *iter = NULL;
   app_message_outbox_begin(&iter);
   if(!iter) return;
+  diagnostics.messages_sent++;
   dict_write_int32(iter, SM_SEQUENCE_NUMBER_KEY, 0xFFFFFFFF);
   app_message_outbox_send();
 }
@@ -118,6 +214,12 @@ void sendCommandInt(int key, int param) {
 }
 
 void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
+  PROFILE_BEGIN(PROFILE_MINUTE_TICK);
+  diagnostics.minute_ticks++;
+
+  if (tick_time->tm_min == 0) {
+    diagnostics_hour_tick();
+  }
 
   setlocale(LC_ALL, i18n_get_system_locale());
 
@@ -156,16 +258,27 @@ void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
     memmove(time_text, &time_text[1], sizeof(time_text) - 1);
   }
 
-  text_layer_set_text(text_time_layer, time_text);
+  time_layer_set_text(time_layer, time_text);
+
+  refresh_update(mktime(tick_time));
 
+  PROFILE_END(PROFILE_MINUTE_TICK);
 }
 
+// Scenario builds hold overlays up long enough for a screenshot.
+
+#ifdef WIZARD_SCENARIOS
+  #define NOTIFICATION_TIMEOUT 4000
+  #define TAP_TIMEOUT 4000
+#else
+  #define NOTIFICATION_TIMEOUT 1000
+  #define TAP_TIMEOUT 3500
+#endif
+
 void notification(int image, int vibration) {
   if (bluetooth_connection_service_peek() == 1) {
     bitmap_layer_set_bitmap(icon_image, icon_imgs[image]);
-    layer_set_hidden(animated_layer[WEATHER_LAYER], true);
-    layer_set_hidden(animated_layer[MUSIC_LAYER], true);
-    layer_set_hidden(animated_layer[CALENDAR_LAYER], true);
+    panels_set_hidden(true);
     layer_set_hidden(message_layer, false);
     if (vibration == 1) {
       static const uint32_t const segments[] = { 50 };
@@ -174,6 +287,7 @@ void notification(int image, int vibration) {
         .num_segments = ARRAY_LENGTH(segments),
       };
       vibes_enqueue_custom_pattern(pat);
+      diagnostics.vibrations++;
     } else if (vibration == 2) {
       static const uint32_t const segments[] = { 50, 100, 50 };
       VibePattern pat = {
@@ -181,112 +295,173 @@ void notification(int image, int vibration) {
         .num_segments = ARRAY_LENGTH(segments),
       };
       vibes_enqueue_custom_pattern(pat);
+      diagnostics.vibrations++;
     }
-    app_timer_register(1000,reset,NULL);
+    diagnostics_timer_register(NOTIFICATION_TIMEOUT,reset,NULL);
+  }
+}
+
+/* Instead of displaying weather icons, we're going to use these
+codes as simplified weather conditions to make translation easier.
+Using a weather API with multilingual support would be ideal (for
+example, openweathermap.org), but the weather fetching is performed
+in the Smartwatch+ phone app so we'll work with what we have :) */
+
+char *weather_condition(uint8_t icon) {
+  if      (icon == 0) { return _("Clear Skies"); }
+  else if (icon == 1) { return _("Raining"); }
+  else if (icon == 2) { return _("Cloudy"); }
+  else if (icon == 3) { return _("Partly Cloudy"); }
+  else if (icon == 4) { return _("Foggy"); }
+  else if (icon == 5) { return _("Windy"); }
+  else if (icon == 6) { return _("Snowing"); }
+  else if (icon == 7) { return _("Stormy"); }
+  else                { return _("It's Currently"); }
+}
+
+// Copies a received string into its buffer. Returns false if it's unchanged,
+// so the layer showing it doesn't have to be redrawn.
+
+bool update_string(char *buffer, size_t size, const char *value) {
+  if (strncmp(buffer, value, size - 1) == 0) return false;
+  strncpy(buffer, value, size - 1);
+  buffer[size - 1] = '\0';
+  return true;
+}
+
+void set_count(Layer *layer, TextLayer *text_layer, char *count) {
+  if (count[0] == '0') {
+    layer_set_hidden(layer, true);
+  } else {
+    text_layer_set_text(text_layer, count);
+    layer_set_hidden(layer, false);
+  }
+}
+
+void set_phone_battery(int percent) {
+  batteryPercent = percent;
+  layer_mark_dirty(battery_layer);
+  snprintf(string_buffer, sizeof(string_buffer), "%d", batteryPercent);
+  text_layer_set_text(text_battery_layer, string_buffer);
+}
+
+void graph_panel_received(GraphPanel *panel, int field, Tuple *t) {
+  if (field == GRAPH_SERIES) {
+    sparkline_layer_set_series(panel->graph_layer, t->value->data, t->length);
+  } else if (update_string(panel->text[field], sizeof(panel->text[field]), t->value->cstring)) {
+    text_layer_set_text(panel->text_layers[field], panel->text[field]);
+  }
+}
+
+// Keys the phone sends with every status push, used to tell whether a push
+// brought anything new.
+
+static bool is_status_key(uint32_t key) {
+  switch (key) {
+    case SM_WEATHER_TEMP_KEY:
+    case SM_WEATHER_ICON_KEY:
+    case SM_COUNT_PHONE_KEY:
+    case SM_COUNT_SMS_KEY:
+    case SM_COUNT_MAIL_KEY:
+    case SM_COUNT_BATTERY_KEY:
+    case SM_STATUS_CAL_TIME_KEY:
+    case SM_STATUS_CAL_TEXT_KEY:
+    case SM_STATUS_MUS_ARTIST_KEY:
+    case SM_STATUS_MUS_TITLE_KEY:
+      return true;
+    default:
+      return false;
   }
 }
 
 void inbox_received_callback(DictionaryIterator *received, void *context) {
 
+  diagnostics.messages_received++;
+  if (!sm_message_in_accept(received)) return;
+  status_updated = time(NULL);
+
+  PROFILE_BEGIN(PROFILE_INBOX);
+
+  bool status = false, changed = false;
   Tuple *t = dict_read_first(received);
-  char *weather_cond;
 
   while(t != NULL) {
+    status = status || is_status_key(t->key);
+
     switch (t->key) {
 
       // Weather Temperature
 
       case SM_WEATHER_TEMP_KEY:
-        memcpy(weather_temp_str, t->value->cstring, strlen(t->value->cstring));
-        weather_temp_str[strlen(t->value->cstring)] = '\0';
-        text_layer_set_text(text_weather_temp_layer, weather_temp_str);
+        if (update_string(weather_temp_str, sizeof(weather_temp_str), t->value->cstring)) {
+          text_layer_set_text(text_weather_temp_layer, weather_temp_str);
+          changed = true;
+        }
       break;
 
       // Weather Condition
-      
       case SM_WEATHER_ICON_KEY:
-
-        /* Instead of displaying weather icons, we're going to use these
-        codes as simplified weather conditions to make translation easier.
-        Using a weather API with multilingual support would be ideal (for
-        example, openweathermap.org), but the weather fetching is performed
-        in the Smartwatch+ phone app so we'll work with what we have :) */
-
-        if      (t->value->uint8 == 0) { weather_cond = _("Clear Skies"); }
-        else if (t->value->uint8 == 1) { weather_cond = _("Raining"); }
-        else if (t->value->uint8 == 2) { weather_cond = _("Cloudy"); }
-        else if (t->value->uint8 == 3) { weather_cond = _("Partly Cloudy"); }
-        else if (t->value->uint8 == 4) { weather_cond = _("Foggy"); }
-        else if (t->value->uint8 == 5) { weather_cond = _("Windy"); }
-        else if (t->value->uint8 == 6) { weather_cond = _("Snowing"); }
-        else if (t->value->uint8 == 7) { weather_cond = _("Stormy"); }
-        else                           { weather_cond = _("It's Currently"); }
-
-        text_layer_set_text(text_weather_cond_layer, weather_cond);
+        if (weather_icon != t->value->uint8) {
+          weather_icon = t->value->uint8;
+          text_layer_set_text(text_weather_cond_layer, weather_condition(weather_icon));
+          changed = true;
+        }
       break;
 
       // Missed Phone Calls
       case SM_COUNT_PHONE_KEY:
-        memcpy(phone_count_str, t->value->cstring, strlen(t->value->cstring));
-        phone_count_str[strlen(t->value->cstring)] = '\0';
-        if (phone_count_str[0] == '0') {
-          layer_set_hidden(phone_layer, true);
-        } else {
-          text_layer_set_text(text_phone_layer, phone_count_str);
-          layer_set_hidden(phone_layer, false);
+        if (update_string(phone_count_str, sizeof(phone_count_str), t->value->cstring)) {
+          set_count(phone_layer, text_phone_layer, phone_count_str);
+          changed = true;
         }
       break;
 
       // Unread Messages
       case SM_COUNT_SMS_KEY:
-        memcpy(sms_count_str, t->value->cstring, strlen(t->value->cstring));
-        sms_count_str[strlen(t->value->cstring)] = '\0';
-        if (sms_count_str[0] == '0') {
-          layer_set_hidden(sms_layer, true);
-        } else {
-          text_layer_set_text(text_sms_layer, sms_count_str);
-          layer_set_hidden(sms_layer, false);
+        if (update_string(sms_count_str, sizeof(sms_count_str), t->value->cstring)) {
+          set_count(sms_layer, text_sms_layer, sms_count_str);
+          changed = true;
         }
       break;
 
       // Unread Emails
       case SM_COUNT_MAIL_KEY:
-      memcpy(mail_count_str, t->value->cstring, strlen(t->value->cstring));
-      mail_count_str[strlen(t->value->cstring)] = '\0';
-      if (mail_count_str[0] == '0') {
-        layer_set_hidden(mail_layer, true);
-      } else {
-        text_layer_set_text(text_mail_layer, mail_count_str);
-        layer_set_hidden(mail_layer, false);
-      }
+        if (update_string(mail_count_str, sizeof(mail_count_str), t->value->cstring)) {
+          set_count(mail_layer, text_mail_layer, mail_count_str);
+          changed = true;
+        }
       break;
 
       // Phone Battery Percentage
       case SM_COUNT_BATTERY_KEY:
-      batteryPercent = t->value->uint8;
-      layer_mark_dirty(battery_layer);
-      snprintf(string_buffer, sizeof(string_buffer), "%d", batteryPercent);
-      text_layer_set_text(text_battery_layer, string_buffer);
+        if (batteryPercent != t->value->uint8) {
+          battery_history_add(&battery_history, time(NULL), t->value->uint8);
+          set_phone_battery(t->value->uint8);
+          changed = true;
+        }
       break;
 
       // Next Calendar Event Time
       case SM_STATUS_CAL_TIME_KEY:
-      memcpy(calendar_date_str, t->value->cstring, strlen(t->value->cstring));
-      calendar_date_str[strlen(t->value->cstring)] = '\0';
-      text_layer_set_text(calendar_date_layer, calendar_date_str);
+        if (update_string(calendar_date_str, sizeof(calendar_date_str), t->value->cstring)) {
+          text_layer_set_text(calendar_date_layer, calendar_date_str);
+          refresh_set_calendar(calendar_date_str);
+          changed = true;
+        }
       break;
 
       // Next Calendar Event Title
       case SM_STATUS_CAL_TEXT_KEY:
-      memcpy(calendar_text_str, t->value->cstring, strlen(t->value->cstring));
-      calendar_text_str[strlen(t->value->cstring)] = '\0';
-      text_layer_set_text(calendar_text_layer, calendar_text_str);
+        if (update_string(calendar_text_str, sizeof(calendar_text_str), t->value->cstring)) {
+          text_layer_set_text(calendar_text_layer, calendar_text_str);
+          changed = true;
+        }
       break;
 
       // Current Song Artist
       case SM_STATUS_MUS_ARTIST_KEY:
-        memcpy(music_artist_str, t->value->cstring, strlen(t->value->cstring));
-        music_artist_str[strlen(t->value->cstring)] = '\0';
+        if (!update_string(music_artist_str, sizeof(music_artist_str), t->value->cstring)) break;
+        changed = true;
 
         if (strcmp(music_artist_str, "No Artist") == 0) {
           text_layer_set_text(music_artist_layer, _("No Artist"));
@@ -297,8 +472,8 @@ void inbox_received_callback(DictionaryIterator *received, void *context) {
 
       // Current Song Title
       case SM_STATUS_MUS_TITLE_KEY:
-        memcpy(music_title_str, t->value->cstring, strlen(t->value->cstring));
-        music_title_str[strlen(t->value->cstring)] = '\0';
+        if (!update_string(music_title_str, sizeof(music_title_str), t->value->cstring)) break;
+        changed = true;
 
         if (strcmp(music_title_str, "No Title") == 0) {
           text_layer_set_text(music_song_layer, _("No Title"));
@@ -307,36 +482,316 @@ void inbox_received_callback(DictionaryIterator *received, void *context) {
         }
       break;
 
+      // Music Playing or Paused, status is kept fresh while it plays
+      case SM_PLAY_STATUS_KEY:
+        refresh_set_playing(t->value->uint8 != 0);
+      break;
+
+      // Stocks Panel
+      case SM_STOCKS_LOW_KEY:
+      case SM_STOCKS_HIGH_KEY:
+      case SM_STOCKS_CURR_KEY:
+      case SM_STOCKS_TITLE_KEY:
+        graph_panel_received(&graph_panels[STOCKS_GRAPH], t->key - SM_STOCKS_LOW_KEY, t);
+      break;
+      case SM_STOCKS_GRAPH_KEY:
+        graph_panel_received(&graph_panels[STOCKS_GRAPH], GRAPH_SERIES, t);
+      break;
+
+      // Bitcoin Panel
+      case SM_BITCOIN_LOW_KEY:
+      case SM_BITCOIN_HIGH_KEY:
+      case SM_BITCOIN_CURR_KEY:
+      case SM_BITCOIN_TITLE_KEY:
+        graph_panel_received(&graph_panels[BITCOIN_GRAPH], t->key - SM_BITCOIN_LOW_KEY, t);
+      break;
+      case SM_BITCOIN_GRAPH_KEY:
+        graph_panel_received(&graph_panels[BITCOIN_GRAPH], GRAPH_SERIES, t);
+      break;
+
+      // Reminders and Messages List Pages
+      case SM_REMINDERS_KEY:
+      case SM_MESSAGES_UPDATE_KEY:
+        list_view_received(t);
+      break;
+
+      // Camera Viewfinder Frame Chunks
+      case SM_STREAMING_BMP_KEY:
+        viewfinder_received(t);
+      break;
+
+      // Diagnostics Request
+      case SM_DIAGNOSTICS_KEY:
+        diagnostics_log();
+        diagnostics_send();
+      break;
+
+      // Turn-by-turn Directions
+      case SM_NAV_ICON_KEY:
+      case SM_NAV_INSTRUCTIONS_KEY:
+        nav_panel_received(t);
+      break;
+
+      // Current Volume
+      case SM_VOLUME_VALUE_KEY:
+        volume_set_confirmed(t->value->uint8);
+        layer_mark_dirty(volume_layer);
+      break;
+
     }
 
     // Get next pair, if any
     t = dict_read_next(received);
   }
 
+  if (status) {
+    refresh_status_received(changed);
+  }
+
+  PROFILE_END(PROFILE_INBOX);
+}
+
+void outbox_sent_callback(DictionaryIterator *sent, void *context) {
+  volume_outbox_result(true);
+  refresh_outbox_result(true);
+  viewfinder_flush();
+  list_view_flush();
+}
+
+void outbox_failed_callback(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+  volume_outbox_result(false);
+  refresh_outbox_result(false);
+  viewfinder_flush();
+  list_view_flush();
 }
 
 // TAP / ACCELEROMETER HANDLER
 
+void set_battery_estimate(TextLayer *text_layer, char *buffer, size_t size, BatteryHistory *history) {
+  if (history->hours_left < 0) {
+    layer_set_hidden(text_layer_get_layer(text_layer), true);
+    return;
+  }
+  if (history->hours_left < 100) {
+    snprintf(buffer, size, "%dh", history->hours_left);
+  } else {
+    snprintf(buffer, size, "%dd", history->hours_left / 24);
+  }
+  text_layer_set_text(text_layer, buffer);
+  layer_set_hidden(text_layer_get_layer(text_layer), false);
+}
+
 void tap_handler(AccelAxisType axis, int32_t direction) {
+  PROFILE_BEGIN(PROFILE_TAP);
+  refresh_activity();
+  set_battery_estimate(text_battery_estimate_layer, battery_estimate_str, sizeof(battery_estimate_str), &battery_history);
+  set_battery_estimate(text_pebble_battery_estimate_layer, pebble_battery_estimate_str, sizeof(pebble_battery_estimate_str), &pebble_battery_history);
   layer_set_hidden(battery_layer, true);
   layer_set_hidden(pebble_battery_layer, true);
   layer_set_hidden(battery_info_layer, false);
   text_layer_set_text(text_date_layer, date_case(day_text));
-  app_timer_register(3500,reset,NULL);
+  diagnostics_timer_register(TAP_TIMEOUT,reset,NULL);
+  PROFILE_END(PROFILE_TAP);
 }
 
-// SELECT KEY HANDLERS
+// CLICK MODES
 
-void select_click_handler(ClickRecognizerRef recognizer, void *context) {
-  ani_out = property_animation_create_layer_frame(animated_layer[active_layer], &GRect(0, 76, 144, 45), &GRect(-144, 76, 144, 45));
+/* A button with both single and multi click handlers normally waits out the
+multi-click timeout before its single click fires. Optimistic buttons fire
+the single click as soon as the button is released instead, and if the
+press turns out to be the start of a multi-click the single click action is
+compensated for (or simply left alone when it's harmless to repeat). */
+
+#define LONG_CLICK_DELAY 500
+#define CLICK_BURST_TIMEOUT 400 // A little longer than the 300ms multi-click timeout
+
+typedef enum {CLICK_DEFERRED, CLICK_OPTIMISTIC} ClickMode;
+
+// Siri can't be taken back once launched, so the top button waits by default.
+
+static ClickMode click_modes[NUM_BUTTONS] = {
+  [BUTTON_ID_UP]     = CLICK_DEFERRED,
+  [BUTTON_ID_SELECT] = CLICK_OPTIMISTIC,
+  [BUTTON_ID_DOWN]   = CLICK_OPTIMISTIC
+};
+
+static uint32_t press_ms[NUM_BUTTONS];
+static AppTimer *click_burst_timer[NUM_BUTTONS];
+static bool volume_mode_pending;
+
+// The stocks and bitcoin panels only get data from the phone while their
+// screen is entered, so tell it when we slide onto or off one of them.
+
+static const int panel_apps[NUM_LAYERS] = {
+  [WEATHER_LAYER] = -1, [CALENDAR_LAYER] = -1, [MUSIC_LAYER] = -1,
+  [STOCKS_LAYER] = STOCKS_APP, [BITCOIN_LAYER] = BITCOIN_APP
+};
+
+void carousel_slide(int next_layer, int direction) {
+  int leaving = panel_apps[active_layer], entering = panel_apps[next_layer];
+  DictionaryIterator *iter;
+
+  if ((leaving >= 0 || entering >= 0) && sm_message_out_get(&iter) == APP_MSG_OK) {
+    if (leaving >= 0) dict_write_int8(iter, SM_SCREEN_EXIT_KEY, leaving);
+    if (entering >= 0) dict_write_int8(iter, SM_SCREEN_ENTER_KEY, entering);
+    app_message_outbox_send();
+  }
+
+  ani_out = property_animation_create_layer_frame(animated_layer[active_layer], &GRect(0, 76, 144, 45), &GRect(-144 * direction, 76, 144, 45));
   animation_schedule((Animation*)ani_out);
-  active_layer = (active_layer + 1) % (NUM_LAYERS);
-  ani_in = property_animation_create_layer_frame(animated_layer[active_layer], &GRect(144, 76, 144, 45), &GRect(0, 76, 144, 45));
+  active_layer = next_layer;
+  ani_in = property_animation_create_layer_frame(animated_layer[active_layer], &GRect(144 * direction, 76, 144, 45), &GRect(0, 76, 144, 45));
   animation_schedule((Animation*)ani_in);
 }
 
+void volume_mode_enter(void);
+
+void click_burst_ended(void *data) {
+  ButtonId button = (ButtonId)data;
+  click_burst_timer[button] = NULL;
+  if (button == BUTTON_ID_SELECT && volume_mode_pending) {
+    volume_mode_pending = false;
+    if (!nav_panel_active()) volume_mode_enter();
+  }
+}
+
+// Returns true if an optimistic single click already fired for this burst.
+
+bool click_burst_compensate(ButtonId button) {
+  if (click_burst_timer[button] == NULL) return false;
+  app_timer_cancel(click_burst_timer[button]);
+  click_burst_timer[button] = NULL;
+  return true;
+}
+
+// VOLUME MODE
+
+/* Pressing select on the music panel swaps the up and down buttons over to
+repeating volume controls. Select again leaves volume mode and carries on
+through the carousel; leaving it alone for a few seconds just leaves. */
+
+#define VOLUME_MODE_TIMEOUT 5000
+#define VOLUME_REPEAT_INTERVAL 100
+
+static bool volume_mode;
+static AppTimer *volume_mode_timer;
+
+void click_config_provider(void *context);
+
+void volume_layer_update_callback(Layer *me, GContext* ctx) {
+  PROFILE_BEGIN(PROFILE_VOLUME_BAR);
+  int volume = volume_get();
+  graphics_context_set_stroke_color(ctx, GColorWhite);
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  graphics_draw_rect(ctx, GRect(8, 8, 116, 12));
+  if (volume > 0) {
+    graphics_fill_rect(ctx, GRect(10, 10, volume * 112 / 100, 8), 0, GCornerNone);
+  }
+  PROFILE_END(PROFILE_VOLUME_BAR);
+}
+
+void volume_mode_exit(bool advance) {
+  if (!volume_mode) return;
+  volume_mode = false;
+  if (volume_mode_timer) {
+    app_timer_cancel(volume_mode_timer);
+    volume_mode_timer = NULL;
+  }
+  layer_set_hidden(volume_layer, true);
+  layer_set_hidden(text_layer_get_layer(music_song_layer), false);
+  window_set_click_config_provider(window, click_config_provider);
+  if (advance) {
+    carousel_slide((active_layer + 1) % (NUM_LAYERS), 1);
+  }
+}
+
+void volume_mode_timeout(void *data) {
+  volume_mode_timer = NULL;
+  volume_mode_exit(false);
+}
+
+void volume_up_handler(ClickRecognizerRef recognizer, void *context) {
+  volume_change(1);
+  layer_mark_dirty(volume_layer);
+  app_timer_reschedule(volume_mode_timer, VOLUME_MODE_TIMEOUT);
+}
+
+void volume_down_handler(ClickRecognizerRef recognizer, void *context) {
+  volume_change(-1);
+  layer_mark_dirty(volume_layer);
+  app_timer_reschedule(volume_mode_timer, VOLUME_MODE_TIMEOUT);
+}
+
+void volume_select_handler(ClickRecognizerRef recognizer, void *context) {
+  volume_mode_exit(true);
+}
+
+void volume_click_config_provider(void *context) {
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, VOLUME_REPEAT_INTERVAL, volume_up_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, VOLUME_REPEAT_INTERVAL, volume_down_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, volume_select_handler);
+}
+
+void volume_mode_enter(void) {
+  if (volume_mode) return;
+  volume_mode = true;
+  layer_set_hidden(text_layer_get_layer(music_song_layer), true);
+  layer_set_hidden(volume_layer, false);
+  volume_mode_timer = diagnostics_timer_register(VOLUME_MODE_TIMEOUT, volume_mode_timeout, NULL);
+  window_set_click_config_provider(window, volume_click_config_provider);
+
+  // Ask for the current volume so the bar starts from the real value.
+
+  volume_request();
+}
+
+// SELECT KEY HANDLERS
+
+// Whether the optimistic single click slid the carousel, so a multi click
+// only undoes a slide that actually happened.
+
+static bool select_click_slid;
+
+void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_SELECT_CLICK, press_ms[BUTTON_ID_SELECT]);
+  select_click_slid = false;
+  if (nav_panel_active()) {
+
+    // The carousel is covered by directions until the route ends.
+
+  } else if (active_layer != MUSIC_LAYER) {
+    carousel_slide((active_layer + 1) % (NUM_LAYERS), 1);
+    select_click_slid = true;
+  } else if (click_burst_timer[BUTTON_ID_SELECT]) {
+
+    // Swapping the click config mid-burst would swallow a double click,
+    // so wait for the burst to end before entering volume mode.
+
+    volume_mode_pending = true;
+  } else {
+    volume_mode_enter();
+  }
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
+}
+
 void select_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_SELECT_MULTI_CLICK, press_ms[BUTTON_ID_SELECT]);
   uint8_t clicks = click_number_of_clicks_counted(recognizer);
+
+  // Slide back to the panel we were on before the first click.
+
+  if (click_burst_compensate(BUTTON_ID_SELECT)) {
+    if (volume_mode_pending) {
+      volume_mode_pending = false;
+    } else if (select_click_slid) {
+      select_click_slid = false;
+      carousel_slide((active_layer + NUM_LAYERS - 1) % (NUM_LAYERS), -1);
+    }
+  }
+
   if (clicks == 2) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_PRESSED_SELECT);
     notification(2,2);
@@ -344,11 +799,27 @@ void select_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_HELD_SELECT);
     notification(2,2);
   }
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
-  sendCommand(SM_PLAYPAUSE_KEY);
-  notification(4,0);
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_SELECT_LONG_CLICK, press_ms[BUTTON_ID_SELECT]);
+  if (nav_panel_active()) {
+
+    // Like a click, a long click can't reach the covered carousel panel.
+
+  } else if (active_layer == CALENDAR_LAYER) {
+    list_view_show(LIST_REMINDERS);
+  } else if (active_layer == WEATHER_LAYER) {
+    viewfinder_show();
+  } else {
+    sendCommand(SM_PLAYPAUSE_KEY);
+    notification(4,0);
+  }
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void select_long_click_release_handler(ClickRecognizerRef recognizer, void *context) {}
@@ -356,12 +827,19 @@ void select_long_click_release_handler(ClickRecognizerRef recognizer, void *cont
 // UP KEY HANDLERS
 
 void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_UP_CLICK, press_ms[BUTTON_ID_UP]);
   sendCommand(SM_OPEN_SIRI_KEY);
   notification(0,0);
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void up_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_UP_MULTI_CLICK, press_ms[BUTTON_ID_UP]);
   uint8_t clicks = click_number_of_clicks_counted(recognizer);
+  click_burst_compensate(BUTTON_ID_UP);
   if (clicks == 2) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_PRESSED_UP);
     notification(2,1);
@@ -369,11 +847,17 @@ void up_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_HELD_UP);
     notification(2,2);
   }
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_UP_LONG_CLICK, press_ms[BUTTON_ID_UP]);
   sendCommand(SM_PREVIOUS_TRACK_KEY);
   notification(6,0);
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void up_long_click_release_handler(ClickRecognizerRef recognizer, void *context) {}
@@ -381,12 +865,22 @@ void up_long_click_release_handler(ClickRecognizerRef recognizer, void *context)
 // DOWN KEY HANDLERS
 
 void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_DOWN_CLICK, press_ms[BUTTON_ID_DOWN]);
   sendCommandInt(SM_SCREEN_ENTER_KEY, STATUS_SCREEN_APP);
   notification(1,0);
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void down_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_DOWN_MULTI_CLICK, press_ms[BUTTON_ID_DOWN]);
   uint8_t clicks = click_number_of_clicks_counted(recognizer);
+
+  // An extra refresh is harmless, so there's nothing to undo.
+
+  click_burst_compensate(BUTTON_ID_DOWN);
   if (clicks == 2) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_PRESSED_DOWN);
     notification(2,1);
@@ -394,37 +888,171 @@ void down_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
     sendCommandInt(SM_ACTIVATOR_KEY_PRESSED, ACTIVATOR_KEY_HELD_DOWN);
     notification(2,2);
   }
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void down_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  PROFILE_BEGIN(PROFILE_CLICK);
+  diagnostics_latency_begin(LATENCY_DOWN_LONG_CLICK, press_ms[BUTTON_ID_DOWN]);
   sendCommand(SM_NEXT_TRACK_KEY);
   notification(5,0);
+  PROFILE_END(PROFILE_CLICK);
+  diagnostics_latency_end();
 }
 
 void down_long_click_release_handler(ClickRecognizerRef recognizer, void *context) {}
 
+// RAW KEY HANDLERS
+
+static ClickHandler single_click_handlers[NUM_BUTTONS] = {
+  [BUTTON_ID_UP]     = up_click_handler,
+  [BUTTON_ID_SELECT] = select_click_handler,
+  [BUTTON_ID_DOWN]   = down_click_handler
+};
+
+void raw_down_handler(ClickRecognizerRef recognizer, void *context) {
+  press_ms[click_recognizer_get_button_id(recognizer)] = diagnostics_now_ms();
+  refresh_activity();
+}
+
+void raw_up_handler(ClickRecognizerRef recognizer, void *context) {
+  ButtonId button = click_recognizer_get_button_id(recognizer);
+  if (click_modes[button] != CLICK_OPTIMISTIC) return;
+
+  // Releases after a long click, or later clicks in the same burst, are the
+  // long and multi click handlers' business.
+
+  if (diagnostics_now_ms() - press_ms[button] >= LONG_CLICK_DELAY) return;
+
+  if (click_burst_timer[button]) {
+    app_timer_reschedule(click_burst_timer[button], CLICK_BURST_TIMEOUT);
+    return;
+  }
+  click_burst_timer[button] = diagnostics_timer_register(CLICK_BURST_TIMEOUT, click_burst_ended, (void*)button);
+  single_click_handlers[button](recognizer, context);
+}
+
 void click_config_provider(void *context) {
-  window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
-  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
-  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+  for (ButtonId button = BUTTON_ID_UP; button <= BUTTON_ID_DOWN; button++) {
+    window_raw_click_subscribe(button, raw_down_handler, raw_up_handler, NULL);
+    if (click_modes[button] == CLICK_DEFERRED) {
+      window_single_click_subscribe(button, single_click_handlers[button]);
+    }
+  }
   window_multi_click_subscribe(BUTTON_ID_SELECT, 2, 10, 0, true, select_multi_click_handler);
   window_multi_click_subscribe(BUTTON_ID_UP, 2, 10, 0, true, up_multi_click_handler);
   window_multi_click_subscribe(BUTTON_ID_DOWN, 2, 10, 0, true, down_multi_click_handler);
-  window_long_click_subscribe(BUTTON_ID_SELECT, 500, select_long_click_handler, select_long_click_release_handler);
-  window_long_click_subscribe(BUTTON_ID_UP, 500, up_long_click_handler, up_long_click_release_handler);
-  window_long_click_subscribe(BUTTON_ID_DOWN, 500, down_long_click_handler, down_long_click_release_handler);
+  window_long_click_subscribe(BUTTON_ID_SELECT, LONG_CLICK_DELAY, select_long_click_handler, select_long_click_release_handler);
+  window_long_click_subscribe(BUTTON_ID_UP, LONG_CLICK_DELAY, up_long_click_handler, up_long_click_release_handler);
+  window_long_click_subscribe(BUTTON_ID_DOWN, LONG_CLICK_DELAY, down_long_click_handler, down_long_click_release_handler);
 }
 
-void battery_layer_update_callback(Layer *me, GContext* ctx) {
+// Covers the empty part of the 16 pixel battery icon. Integer maths only,
+// since there's no FPU to do it in floating point.
+
+void draw_battery_gauge(GContext* ctx, int percent) {
+  PROFILE_BEGIN(PROFILE_BATTERY_GAUGE);
   graphics_context_set_stroke_color(ctx, GColorWhite);
   graphics_context_set_fill_color(ctx, GColorBlack);
-  graphics_fill_rect(ctx, GRect((int)((batteryPercent/100.0)*16.0)-16, 0, 16, 8), 0, GCornerNone);
+  graphics_fill_rect(ctx, GRect(percent * 16 / 100 - 16, 0, 16, 8), 0, GCornerNone);
+  PROFILE_END(PROFILE_BATTERY_GAUGE);
+}
+
+void battery_layer_update_callback(Layer *me, GContext* ctx) {
+  draw_battery_gauge(ctx, batteryPercent);
 }
 
 void pebble_battery_layer_update_callback(Layer *me, GContext* ctx) {
-  graphics_context_set_stroke_color(ctx, GColorWhite);
-  graphics_context_set_fill_color(ctx, GColorBlack);
-  graphics_fill_rect(ctx, GRect((int)((batteryPblPercent/100.0)*16.0)-16, 0, 16, 8), 0, GCornerNone);
+  draw_battery_gauge(ctx, batteryPblPercent);
+}
+
+// STATUS CACHE
+
+/* The last status is saved on exit and shown straight away on the next
+launch, until the phone's reply to the usual full status request replaces
+it. It's only a copy of what was last shown: nothing updates it while the
+app is closed, so it's only used when the background worker says the
+phone has stayed connected since it was saved, and it's recent. */
+
+static StatusCache status_cache;
+
+void status_cache_load(void) {
+  WorkerState worker;
+
+  if (persist_read_data(PERSIST_STATUS_KEY, &status_cache, sizeof(status_cache)) != sizeof(status_cache)
+      || status_cache.version != STATUS_CACHE_VERSION
+      || !bluetooth_connection_service_peek()) {
+    status_cache.version = 0;
+    return;
+  }
+
+  if (persist_read_data(PERSIST_WORKER_KEY, &worker, sizeof(worker)) != sizeof(worker)
+      || !worker.connected
+      || worker.connection_changed > status_cache.updated
+      || time(NULL) - status_cache.updated >= STATUS_CACHE_MAX_AGE) {
+    status_cache.version = 0;
+  }
+}
+
+void status_cache_apply(void) {
+  if (status_cache.version != STATUS_CACHE_VERSION) return;
+
+  status_updated = status_cache.updated;
+
+  update_string(weather_temp_str, sizeof(weather_temp_str), status_cache.weather_temp);
+  text_layer_set_text(text_weather_temp_layer, weather_temp_str);
+  weather_icon = status_cache.weather_icon;
+  text_layer_set_text(text_weather_cond_layer, weather_condition(weather_icon));
+
+  update_string(phone_count_str, sizeof(phone_count_str), status_cache.phone_count);
+  set_count(phone_layer, text_phone_layer, phone_count_str);
+  update_string(sms_count_str, sizeof(sms_count_str), status_cache.sms_count);
+  set_count(sms_layer, text_sms_layer, sms_count_str);
+  update_string(mail_count_str, sizeof(mail_count_str), status_cache.mail_count);
+  set_count(mail_layer, text_mail_layer, mail_count_str);
+
+  set_phone_battery(status_cache.phone_battery);
+
+  update_string(calendar_date_str, sizeof(calendar_date_str), status_cache.calendar_date);
+  text_layer_set_text(calendar_date_layer, calendar_date_str);
+  refresh_set_calendar(calendar_date_str);
+  update_string(calendar_text_str, sizeof(calendar_text_str), status_cache.calendar_text);
+  text_layer_set_text(calendar_text_layer, calendar_text_str);
+}
+
+void status_cache_save(void) {
+
+  // Counts are blanked while disconnected, so there's nothing worth keeping.
+
+  if (status_updated == 0 || !bluetooth_connection_service_peek()) return;
+
+  status_cache.version = STATUS_CACHE_VERSION;
+  status_cache.updated = status_updated;
+  status_cache.phone_battery = batteryPercent;
+  status_cache.weather_icon = weather_icon;
+  update_string(status_cache.weather_temp, sizeof(status_cache.weather_temp), weather_temp_str);
+  update_string(status_cache.phone_count, sizeof(status_cache.phone_count), phone_count_str);
+  update_string(status_cache.sms_count, sizeof(status_cache.sms_count), sms_count_str);
+  update_string(status_cache.mail_count, sizeof(status_cache.mail_count), mail_count_str);
+  update_string(status_cache.calendar_date, sizeof(status_cache.calendar_date), calendar_date_str);
+  update_string(status_cache.calendar_text, sizeof(status_cache.calendar_text), calendar_text_str);
+  persist_write_data(PERSIST_STATUS_KEY, &status_cache, sizeof(status_cache));
+}
+
+// Sits on top of everything and draws nothing; it's only here to be called
+// once for every redraw of the window.
+
+void redraw_counter_update_callback(Layer *me, GContext* ctx) {
+  diagnostics.redraws_this_hour++;
+  diagnostics.redraws++;
+  diagnostics_frame_end();
+}
+
+// Its counterpart underneath everything, so frames can be timed.
+
+void frame_start_update_callback(Layer *me, GContext* ctx) {
+  diagnostics_frame_begin();
 }
 
 static void window_load(Window *window) {}
@@ -446,9 +1074,16 @@ void reconnect(void *data) {
 
 void bluetoothChanged(bool connected) {
   if (connected) {
-    app_timer_register(5000, reconnect, NULL);
+
+    // The phone may have restarted its numbering while we were away.
+
+    s_inbound_sequence_number = 0;
+    refresh_reconnected();
+    nav_panel_set_connected(true);
+    diagnostics_timer_register(5000, reconnect, NULL);
     reset();
   } else {
+    volume_mode_exit(false);
     bitmap_layer_set_bitmap(icon_image, icon_imgs[3]);
 
     // Set the phone battery to 0%.
@@ -456,10 +1091,14 @@ void bluetoothChanged(bool connected) {
     batteryPercent = 0;
     layer_mark_dirty(battery_layer);
 
-    layer_set_hidden(animated_layer[WEATHER_LAYER], true);
-    layer_set_hidden(animated_layer[MUSIC_LAYER], true);
-    layer_set_hidden(animated_layer[CALENDAR_LAYER], true);
-    layer_set_hidden(message_layer, false);
+    // Directions stay up with the last instruction, since that's still
+    // more use than the disconnected icon.
+
+    nav_panel_set_connected(false);
+    if (!nav_panel_active()) {
+      panels_set_hidden(true);
+      layer_set_hidden(message_layer, false);
+    }
 
     // Un-hide the following layers so we can cover up the checkmarks.
 
@@ -471,18 +1110,64 @@ void bluetoothChanged(bool connected) {
     text_layer_set_text(text_mail_layer, "");
     text_layer_set_text(text_battery_layer, "");
 
+    // Forget the counts as well, so they're redrawn once the phone is back.
+
+    phone_count_str[0] = sms_count_str[0] = mail_count_str[0] = '\0';
+
     vibes_double_pulse();
+    diagnostics.vibrations++;
   }
 }
 
 void batteryChanged(BatteryChargeState batt) {
+  if (batt.is_charging || batt.is_plugged) {
+    battery_history_reset(&pebble_battery_history);
+  } else {
+    battery_history_add(&pebble_battery_history, time(NULL), batt.charge_percent);
+  }
+
   batteryPblPercent = batt.charge_percent;
   snprintf(pebble_buffer, sizeof(pebble_buffer), "%d", batteryPblPercent);
   text_layer_set_text(text_pebble_battery_layer, pebble_buffer);
   layer_mark_dirty(pebble_battery_layer);
 }
 
+// Title and current value on top, with the sparkline underneath and the
+// high and low stacked beside it.
+
+TextLayer *graph_panel_text_create(Layer *parent, GRect frame, GTextAlignment alignment, const char *font) {
+  TextLayer *text_layer = text_layer_create(frame);
+  text_layer_set_text_alignment(text_layer, alignment);
+  text_layer_set_text_color(text_layer, GColorWhite);
+  text_layer_set_background_color(text_layer, GColorClear);
+  text_layer_set_font(text_layer, fonts_get_system_font(font));
+  layer_add_child(parent, text_layer_get_layer(text_layer));
+  return text_layer;
+}
+
+void graph_panel_create(GraphPanel *panel, Layer *parent, char *placeholder) {
+  panel->text_layers[GRAPH_TITLE] = graph_panel_text_create(parent, GRect(6, -1, 80, 21), GTextAlignmentLeft, FONT_KEY_GOTHIC_18);
+  panel->text_layers[GRAPH_CURR] = graph_panel_text_create(parent, GRect(86, -1, 52, 21), GTextAlignmentRight, FONT_KEY_GOTHIC_18_BOLD);
+  panel->text_layers[GRAPH_HIGH] = graph_panel_text_create(parent, GRect(104, 17, 34, 14), GTextAlignmentRight, FONT_KEY_GOTHIC_14);
+  panel->text_layers[GRAPH_LOW] = graph_panel_text_create(parent, GRect(104, 29, 34, 14), GTextAlignmentRight, FONT_KEY_GOTHIC_14);
+  text_layer_set_text(panel->text_layers[GRAPH_TITLE], placeholder);
+
+  panel->graph_layer = sparkline_layer_create(GRect(6, 21, 96, 22));
+  layer_add_child(parent, panel->graph_layer);
+}
+
+void graph_panel_destroy(GraphPanel *panel) {
+  for (int i = 0; i < NUM_GRAPH_TEXTS; i++) {
+    text_layer_destroy(panel->text_layers[i]);
+  }
+  sparkline_layer_destroy(panel->graph_layer);
+}
+
 static void init(void) {
+  diagnostics.started = time(NULL);
+  refresh_activity();
+  status_cache_load();
+
   window = window_create();
   window_set_fullscreen(window, true);
 
@@ -506,6 +1191,10 @@ static void init(void) {
   Layer *window_layer = window_get_root_layer(window);
   GRect bg_bounds = layer_get_frame(window_layer);
 
+  frame_start_layer = layer_create(bg_bounds);
+  layer_set_update_proc(frame_start_layer, frame_start_update_callback);
+  layer_add_child(window_layer, frame_start_layer);
+
   background_image = bitmap_layer_create(bg_bounds);
   layer_add_child(window_layer, bitmap_layer_get_layer(background_image));
   bitmap_layer_set_bitmap(background_image, bg_image);
@@ -518,13 +1207,8 @@ static void init(void) {
   text_layer_set_font(text_date_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
   layer_add_child(window_layer, text_layer_get_layer(text_date_layer));
 
-  text_time_layer = text_layer_create(bg_bounds);
-  text_layer_set_text_alignment(text_time_layer, GTextAlignmentCenter);
-  text_layer_set_text_color(text_time_layer, GColorWhite);
-  text_layer_set_background_color(text_time_layer, GColorClear);
-  layer_set_frame(text_layer_get_layer(text_time_layer), GRect(0, 20, 144, 50));
-  text_layer_set_font(text_time_layer, fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SQUARE_48)));
-  layer_add_child(window_layer, text_layer_get_layer(text_time_layer));
+  time_layer = time_layer_create(GRect(0, 20, 144, 50));
+  layer_add_child(window_layer, time_layer);
 
   animated_layer[WEATHER_LAYER] = layer_create(GRect(0, 76, 144, 45));
   layer_add_child(window_layer, animated_layer[WEATHER_LAYER]);
@@ -583,6 +1267,19 @@ static void init(void) {
   layer_add_child(animated_layer[MUSIC_LAYER], text_layer_get_layer(music_song_layer));
   text_layer_set_text(music_song_layer, _("No Title")); // "Title"
 
+  volume_layer = layer_create(GRect(6, 15, 132, 28));
+  layer_set_update_proc(volume_layer, volume_layer_update_callback);
+  layer_add_child(animated_layer[MUSIC_LAYER], volume_layer);
+  layer_set_hidden(volume_layer, true);
+
+  animated_layer[STOCKS_LAYER] = layer_create(GRect(144, 76, 144, 45));
+  layer_add_child(window_layer, animated_layer[STOCKS_LAYER]);
+  graph_panel_create(&graph_panels[STOCKS_GRAPH], animated_layer[STOCKS_LAYER], app_names[STOCKS_APP]);
+
+  animated_layer[BITCOIN_LAYER] = layer_create(GRect(144, 76, 144, 45));
+  layer_add_child(window_layer, animated_layer[BITCOIN_LAYER]);
+  graph_panel_create(&graph_panels[BITCOIN_GRAPH], animated_layer[BITCOIN_LAYER], app_names[BITCOIN_APP]);
+
   mail_layer = layer_create(GRect(63, 128, 30, 18));
   layer_add_child(window_layer, mail_layer);
   layer_set_clips(mail_layer,true);
@@ -638,6 +1335,20 @@ static void init(void) {
   layer_add_child(battery_info_layer, text_layer_get_layer(text_pebble_battery_layer));
   text_layer_set_text(text_pebble_battery_layer, "");
 
+  text_battery_estimate_layer = text_layer_create(GRect(62, 15, 34, 20));
+  text_layer_set_text_alignment(text_battery_estimate_layer, GTextAlignmentRight);
+  text_layer_set_text_color(text_battery_estimate_layer, GColorBlack);
+  text_layer_set_background_color(text_battery_estimate_layer, GColorWhite);
+  text_layer_set_font(text_battery_estimate_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+  layer_add_child(battery_info_layer, text_layer_get_layer(text_battery_estimate_layer));
+
+  text_pebble_battery_estimate_layer = text_layer_create(GRect(62, -2, 34, 20));
+  text_layer_set_text_alignment(text_pebble_battery_estimate_layer, GTextAlignmentRight);
+  text_layer_set_text_color(text_pebble_battery_estimate_layer, GColorBlack);
+  text_layer_set_background_color(text_pebble_battery_estimate_layer, GColorWhite);
+  text_layer_set_font(text_pebble_battery_estimate_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+  layer_add_child(battery_info_layer, text_layer_get_layer(text_pebble_battery_estimate_layer));
+
   layer_set_hidden(battery_info_layer, true);
 
   battery_layer = layer_create(GRect(104, 153, 16, 8));
@@ -651,12 +1362,36 @@ static void init(void) {
   layer_set_update_proc(pebble_battery_layer, pebble_battery_layer_update_callback);
   layer_add_child(window_layer, pebble_battery_layer);
 
+  // Battery history carries over between launches, so drain that happened
+  // while Wizard was closed still counts.
+
+  if (persist_read_data(PERSIST_PHONE_BATTERY_KEY, &battery_history, sizeof(battery_history)) != sizeof(battery_history)) {
+    battery_history_reset(&battery_history);
+  }
+  if (persist_read_data(PERSIST_WATCH_BATTERY_KEY, &pebble_battery_history, sizeof(pebble_battery_history)) != sizeof(pebble_battery_history)) {
+    battery_history_reset(&pebble_battery_history);
+  }
+
+#ifdef WIZARD_SCENARIOS
+  // The scenes set the watch battery themselves
+  BatteryChargeState pbl_batt = { .charge_percent = 70 };
+#else
   BatteryChargeState pbl_batt = battery_state_service_peek();
+#endif
+  if (pbl_batt.is_charging || pbl_batt.is_plugged) {
+    battery_history_reset(&pebble_battery_history);
+  } else {
+    battery_history_add(&pebble_battery_history, time(NULL), pbl_batt.charge_percent);
+  }
   batteryPblPercent = pbl_batt.charge_percent;
   snprintf(pebble_buffer, sizeof(pebble_buffer), "%d", batteryPblPercent);
   text_layer_set_text(text_pebble_battery_layer, pebble_buffer);
   layer_mark_dirty(pebble_battery_layer);
 
+  nav_layer = nav_panel_create(GRect(0, 76, 144, 45), nav_route_changed);
+  layer_add_child(window_layer, nav_layer);
+  layer_set_hidden(nav_layer, true);
+
   message_layer = layer_create(GRect(0, 76, 144, 45));
   layer_add_child(window_layer, message_layer);
 
@@ -666,21 +1401,43 @@ static void init(void) {
 
   layer_set_hidden(message_layer, true);
 
+  redraw_counter_layer = layer_create(bg_bounds);
+  layer_set_update_proc(redraw_counter_layer, redraw_counter_update_callback);
+  layer_add_child(window_layer, redraw_counter_layer);
+
   active_layer = WEATHER_LAYER;
 
+#ifdef WIZARD_SIMULATE_DAY
+  simulation_start();
+#elif defined(WIZARD_SCENARIOS)
+  scenarios_start();
+#else
   tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
+#endif
 	bluetooth_connection_service_subscribe(bluetoothChanged);
+#ifndef WIZARD_SCENARIOS
 	battery_state_service_subscribe(batteryChanged);
+#endif
   accel_tap_service_subscribe(tap_handler);
+
+  status_cache_apply();
+
+  if (!app_worker_is_running()) {
+    app_worker_launch();
+  }
 }
 
 static void deinit(void) {
+  status_cache_save();
+  persist_write_data(PERSIST_PHONE_BATTERY_KEY, &battery_history, sizeof(battery_history));
+  persist_write_data(PERSIST_WATCH_BATTERY_KEY, &pebble_battery_history, sizeof(pebble_battery_history));
+
   animation_destroy((Animation*)ani_in);
   animation_destroy((Animation*)ani_out);
   text_layer_destroy(text_weather_cond_layer);
   text_layer_destroy(text_weather_temp_layer);
   text_layer_destroy(text_date_layer);
-  text_layer_destroy(text_time_layer);
+  time_layer_destroy(time_layer);
   text_layer_destroy(text_mail_layer);
   text_layer_destroy(text_sms_layer);
   text_layer_destroy(text_phone_layer);
@@ -690,13 +1447,23 @@ static void deinit(void) {
   text_layer_destroy(music_song_layer);
   text_layer_destroy(text_battery_layer);
   text_layer_destroy(text_pebble_battery_layer);
+  text_layer_destroy(text_battery_estimate_layer);
+  text_layer_destroy(text_pebble_battery_estimate_layer);
   layer_destroy(battery_info_layer);
   layer_destroy(battery_layer);
   layer_destroy(pebble_battery_layer);
   layer_destroy(mail_layer);
   layer_destroy(sms_layer);
   layer_destroy(phone_layer);
+  nav_panel_destroy(nav_layer);
   layer_destroy(message_layer);
+  layer_destroy(volume_layer);
+  layer_destroy(redraw_counter_layer);
+  layer_destroy(frame_start_layer);
+
+  for (int i=0; i<NUM_GRAPHS; i++) {
+    graph_panel_destroy(&graph_panels[i]);
+  }
 
 	for (int i=0; i<NUM_LAYERS; i++) {
 		layer_destroy(animated_layer[i]);
@@ -717,14 +1484,23 @@ static void deinit(void) {
 }
 
 int main(void) {
+
+  // Scenes only use the data the scenarios inject; nothing is sent to the
+  // phone and nothing it sends can replace them before the screenshot.
+
+#ifndef WIZARD_SCENARIOS
 	app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum() );
 	app_message_register_inbox_received(inbox_received_callback);
+	app_message_register_outbox_sent(outbox_sent_callback);
+	app_message_register_outbox_failed(outbox_failed_callback);
+#endif
 
-  init();
   locale_init();
+  init();
 
   app_event_loop();
 	app_message_deregister_callbacks();
 
+  diagnostics_log();
   deinit();
 }
@@ -0,0 +1,69 @@
+"""Rasterizes the clock font's glyphs into one packed 1-bit sprite sheet.
+
+The sheet is written in the Pebble bitmap (.pbi) layout, so the watch can
+use it straight from the resource with gbitmap_create_with_data(). The
+glyph edges follow the pixels:
+
+  uint16 row_size_bytes, uint16 info_flags, int16 x, y, w, h
+  h rows of row_size_bytes, least significant bit leftmost, 1 is white
+  uint16 edge[len(GLYPHS) + 1], glyph i spans edge[i] to edge[i + 1]
+
+Each glyph gets a cell as wide as its advance and as tall as the font's
+line, with the glyph already placed on the baseline.
+
+The sheet is committed, so this only needs running when the font changes:
+
+  python tools/glyph_sheet.py resources/fonts/square.ttf resources/data/time_digits.bin 48
+"""
+
+import os
+import struct
+import sys
+
+GLYPHS = ':0123456789'
+
+
+def generate(font_path, out_path, height):
+    import freetype
+
+    face = freetype.Face(font_path)
+    face.set_pixel_sizes(0, height)
+    ascender = face.size.ascender >> 6
+    line_height = (face.size.ascender - face.size.descender) >> 6
+
+    glyphs = []
+    for c in GLYPHS:
+        face.load_char(c, freetype.FT_LOAD_RENDER | freetype.FT_LOAD_TARGET_MONO)
+        slot = face.glyph
+        bitmap = slot.bitmap
+        rows = []
+        for y in range(bitmap.rows):
+            row = bitmap.buffer[y * bitmap.pitch:(y + 1) * bitmap.pitch]
+            rows.append([(row[x >> 3] >> (7 - (x & 7))) & 1 for x in range(bitmap.width)])
+        glyphs.append((slot.advance.x >> 6, slot.bitmap_left, ascender - slot.bitmap_top, rows))
+
+    edges = [0]
+    for advance, _, _, _ in glyphs:
+        edges.append(edges[-1] + advance)
+    width = edges[-1]
+    row_size = (width + 31) // 32 * 4  # Pebble bitmap rows are word aligned
+
+    pixels = bytearray(row_size * line_height)
+    for edge, (advance, left, top, rows) in zip(edges, glyphs):
+        for y, row in enumerate(rows):
+            for x, bit in enumerate(row):
+                px, py = edge + left + x, top + y
+                if bit and edge <= px < edge + advance and 0 <= py < line_height:
+                    pixels[py * row_size + (px >> 3)] |= 1 << (px & 7)
+
+    out_dir = os.path.dirname(out_path)
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    with open(out_path, 'wb') as f:
+        f.write(struct.pack('<HHhhhh', row_size, 1 << 12, 0, 0, width, line_height))
+        f.write(pixels)
+        f.write(struct.pack('<%dH' % len(edges), *edges))
+
+
+if __name__ == '__main__':
+    generate(sys.argv[1], sys.argv[2], int(sys.argv[3]))
@@ -0,0 +1,94 @@
+"""Checks rendering against golden frames on a watch.
+
+Build and run the scenario build, then compare each scene it logs with
+tools/golden/<name>.png and print its render time and redraw count next
+to the golden run's:
+
+  WIZARD_SCENARIOS=1 pebble build
+  python tools/golden_frames.py [--update] [pebble tool options]
+
+--update replaces the golden frames and timings with this run's, and has
+to be run once on a known good build before there is anything to compare
+against. Exits non-zero if any frame differs.
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+import png
+
+GOLDEN = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'golden')
+TIMINGS = os.path.join(GOLDEN, 'timings.txt')
+FRAME = re.compile(r'frame (\S+): (\d+) ms, (\d+) redraws')
+
+
+def pixels(path):
+    width, height, rows, _ = png.Reader(filename=path).asRGBA8()
+    return width, height, [bytes(bytearray(row)) for row in rows]
+
+
+def load_timings():
+    timings = {}
+    if os.path.exists(TIMINGS):
+        for line in open(TIMINGS):
+            name, ms, redraws = line.split()
+            timings[name] = (int(ms), int(redraws))
+    return timings
+
+
+def main(args):
+    update = '--update' in args
+    pebble_args = [a for a in args if a != '--update']
+    golden_timings = load_timings()
+    timings = {}
+    failed = []
+
+    if not os.path.isdir(GOLDEN):
+        os.makedirs(GOLDEN)
+
+    logs = subprocess.Popen(['pebble', 'install', '--logs'] + pebble_args,
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    for line in iter(logs.stdout.readline, ''):
+        if 'scenarios done' in line:
+            break
+        match = FRAME.search(line)
+        if not match:
+            continue
+
+        name = match.group(1)
+        timings[name] = tuple(int(g) for g in match.groups()[1:])
+        golden = os.path.join(GOLDEN, name + '.png')
+        shot = golden if update else os.path.join(GOLDEN, name + '.new.png')
+        subprocess.check_call(['pebble', 'screenshot'] + pebble_args + [shot])
+
+        if update:
+            status = 'updated'
+        elif not os.path.exists(golden):
+            status = 'no golden frame'
+            failed.append(name)
+        elif pixels(shot) != pixels(golden):
+            status = 'DIFFERS, see ' + os.path.basename(shot)
+            failed.append(name)
+        else:
+            status = 'identical'
+            os.remove(shot)
+
+        was = golden_timings.get(name)
+        print('%-20s %4d ms %3d redraws  (golden %s)  %s' % (
+            (name,) + timings[name] +
+            ('%d ms %d redraws' % was if was else 'none', status)))
+
+    logs.terminate()
+
+    if update:
+        with open(TIMINGS, 'w') as f:
+            for name in sorted(timings):
+                f.write('%s %d %d\n' % ((name,) + timings[name]))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
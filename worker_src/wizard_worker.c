@@ -0,0 +1,38 @@
+#include <pebble_worker.h>
+#include "../src/status_cache.h"
+
+/* The worker stays resident while Wizard is closed and records when the
+phone connection last changed. Workers can't use AppMessage, so it can't
+keep the app's status cache current; if the link dropped after the cache
+was saved, the app doesn't show it on launch. */
+
+static WorkerState state;
+
+static void save_state(void) {
+  persist_write_data(PERSIST_WORKER_KEY, &state, sizeof(state));
+}
+
+static void connection_handler(bool connected) {
+  state.connected = connected;
+  state.connection_changed = time(NULL);
+  save_state();
+}
+
+static void worker_init(void) {
+
+  // We can't know how long an existing connection has been up, so treat
+  // it as starting now; the app skips its cache at most once.
+
+  connection_handler(bluetooth_connection_service_peek());
+  bluetooth_connection_service_subscribe(connection_handler);
+}
+
+static void worker_deinit(void) {
+  bluetooth_connection_service_unsubscribe();
+}
+
+int main(void) {
+  worker_init();
+  worker_event_loop();
+  worker_deinit();
+}